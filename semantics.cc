@@ -10,7 +10,35 @@
 #include <vector>
 #include <iostream>
 #include <map>
+#include <set>
+#include <sstream>
 #include <cmath>
+#include <cctype>
+#include <climits>
+#include <ctime>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/file.h>
+#include <dirent.h>
+#include <utime.h>
+#include <csignal>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <exception>
 
 
 
@@ -24,6 +52,20 @@ union Multivalue {
     char cValue;
 } value;
 
+//Heterogeneous values alive on this thread now and at most (symbol table entries and
+//expression temporaries alike), kept by the constructors and destructor for --mem-stats;
+//the flag is set while parsing options, before any value exists, so without it nothing
+//is counted and a value's constructor and destructor stay as cheap as before
+bool memStats;
+thread_local long long valuesLive;
+thread_local long long valuesPeak;
+
+inline void countValue () {
+    if ( memStats && ++valuesLive > valuesPeak ) {
+        valuesPeak = valuesLive;
+    }
+}
+
 //heterogeneous object holds a type and a value (provided by Professor Irfan)
 class Heterogeneous {
 public:
@@ -34,24 +76,298 @@ public:
     Heterogeneous(string type, Multivalue value) {
         this->type = type;
         this->value = value;
+        countValue();
     }
     
-    //default constructor
-    Heterogeneous() {}
+    //default constructor (zeroed, so an entry created by assigning to an undeclared id
+    //reads the same on every thread)
+    Heterogeneous() {
+        value.iValue = 0;
+        countValue();
+    }
+
+    //copies and moves are counted too; assignment creates no new value
+    Heterogeneous(const Heterogeneous &other) : type(other.type), value(other.value) {
+        countValue();
+    }
+    Heterogeneous(Heterogeneous &&other) : type(move(other.type)), value(other.value) {
+        countValue();
+    }
+    Heterogeneous &operator=(const Heterogeneous &other) = default;
+    Heterogeneous &operator=(Heterogeneous &&other) = default;
+
+    ~Heterogeneous() {
+        if ( memStats ) {
+            valuesLive--;
+        }
+    }
 };
 
 //global variables used are vectors for holding tokens and lexemes,
 //a counter for keeping track of current index in the token vector,
 //an index to keep track of the most recent type lexeme in a string of declarations,
 //and a map to hold symbols with their types and values
-vector<string> *tokens;
-vector<string> *lexemes;
-int currToken;
-int lastTypeIndex;
-map<string, Heterogeneous> symTable;
+//(all interpreter state is thread_local so server workers can each run a program)
+thread_local vector<string> *tokens;
+thread_local vector<string> *lexemes;
+thread_local int currToken;
+thread_local int lastTypeIndex;
+thread_local map<string, Heterogeneous> symTable;
+
+//fixed-size arrays: the symbol table holds an entry of type "int[]" (etc.) whose value is
+//the length, and the elements live here in one contiguous block per array
+struct ArrayStorage {
+    string type;                    //element type
+    vector<Multivalue> elements;
+};
+thread_local map<string, ArrayStorage> arrayTable;
+//longest array a declaration may ask for (64 MB of elements)
+const long long MAX_ARRAY_LENGTH = 1 << 24;
+
+//element-wise loops: a loop body is one statement, so a loop that walks an array is written
+//"while (i < n) if (true) a[i] = <expression>; else i = i + k;" (the else branch runs its
+//assignment too).  When the expression only combines elements [i] of int arrays, int
+//scalars and int literals with + - *, the loop is compiled to a postfix program and run a
+//block of elements at a time, each operator one tight loop over the block
+enum ElementOpKind { ELEMENT_ARRAY, ELEMENT_INDEX, ELEMENT_CONST, ELEMENT_ADD, ELEMENT_SUB, ELEMENT_MUL };
+struct ElementOp {
+    ElementOpKind kind;
+    const Multivalue *elements;     //ELEMENT_ARRAY: the array read at [i]
+    uint32_t value;                 //ELEMENT_CONST: the scalar or literal
+};
+const int ELEMENT_BLOCK = 256;
+const int ELEMENT_DEPTH = 8;
+
+//stream that print statements and error messages are written to, and whether errors
+//should end only the current program (stop() throws ProgramStop) instead of the process
+thread_local ostream *out = &cout;
+thread_local bool containedRun;
+struct ProgramStop {
+    int status;
+};
+
+//numeric literal values decoded ahead of time by the loader, indexed like the lexeme
+//vector (null when the program was loaded from a stream)
+struct DecodedLiteral {
+    Multivalue value;
+    bool decoded;
+};
+thread_local vector<DecodedLiteral> *tokenLiterals;
+
+//threads used to load a token text file; each gets at least a megabyte of it
+int loadThreads = max(1u, thread::hardware_concurrency());
+const size_t LOAD_CHUNK_MIN = 1 << 20;
+
+//threads used to type check top-level statements; each gets at least this many of them
+int checkThreads = max(1u, thread::hardware_concurrency());
+const int CHECK_CHUNK_MIN = 4096;
+
+//header at the start of a compiled token image; it is followed by the kind table,
+//lexeme ids, decoded literal values, string pool offsets, kind bytes, decoded flags
+//and finally the string pool itself
+const char TOKEN_IMAGE_MAGIC[4] = { 'C', 'T', 'O', 'K' };
+const uint32_t TOKEN_IMAGE_VERSION = 1;
+//header at the start of a program snapshot: the symbol slots resolved by declarations()
+//follow it, then a complete token image of the program after the dead-store pass.  It is
+//a snapshot of the state just before the first statement, not a compiled form: execution
+//still goes through the grammar functions, which evaluate as they parse
+const char SNAPSHOT_MAGIC[4] = { 'C', 'I', 'M', 'G' };
+const uint32_t SNAPSHOT_VERSION = 2;
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t sourceHash;        //checksum of the input file the snapshot was built from
+    uint32_t sourceInput;       //1 if that input was CLite source rather than tokens
+    uint32_t firstStatement;    //token index where statements() begins
+    uint32_t symbolCount;
+    uint32_t symbolBytes;
+    uint64_t checksum;          //FNV-1a over everything after the header
+};
+
+struct TokenImageHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t tokenCount;
+    uint32_t lexemeCount;
+    uint32_t kindCount;
+    uint32_t poolCount;
+    uint32_t poolBytes;
+    uint32_t reserved;
+    uint64_t checksum;      //FNV-1a over everything after the header
+};
+
+//execution governor: counts of executed statements and while-loop back-edges, the
+//budgets they are checked against, and the exit statuses used when one runs out
+thread_local long long stepCount;
+thread_local long long loopIterations;
+long long maxSteps = LLONG_MAX;
+double maxMillis;
+thread_local chrono::steady_clock::time_point startTime;
+const int STEP_LIMIT_STATUS = 3;
+const int TIME_LIMIT_STATUS = 4;
+//status the scheduler gives a program whose file could not be loaded
+const int LOAD_ERROR_STATUS = 2;
+//status of a run whose --resume checkpoint is corrupt or belongs to another program
+const int CHECKPOINT_ERROR_STATUS = 5;
+//whether --stats was given, so modes with counts of their own report them too
+bool showStats;
+
+//memory accounting: resident memory at the end of each phase of the run (load, parse,
+//then execute or check), reported with the byte counts of the interpreter's storage
+struct MemPhase {
+    string name;
+    long rssKB;         //resident set size when the phase ended
+    long peakKB;        //highest resident set size so far
+};
+//the byte counts are taken when the last phase ends, before exit() destroys the
+//thread_local tables they are counted from
+struct MemFigures {
+    bool measured;
+    size_t tokens;
+    size_t tokenBytes;
+    size_t lexemeBytes;
+    size_t literalBytes;
+    size_t symbols;
+    size_t symbolBytes;
+    size_t arrays;
+    size_t arrayBytes;
+    size_t siteBytes;
+    long long valuesLive;
+    long long valuesPeak;
+};
+string memJsonFile;
+vector<MemPhase> memPhases;
+MemFigures memFigures;
+string memFinalPhase = "execute";
+
+//quickening: after an operator site in equality(), relation() or addition() runs once,
+//the operand kinds it saw and the specialized form it needs are recorded here, indexed
+//like the token vector; later runs of the site take the form directly while the kinds
+//still match (the guard), and fall back to the generic code and re-specialize if not
+enum OperandKind { OPERAND_OTHER, OPERAND_FLOAT, OPERAND_FLOAT_LITERAL, OPERAND_CHAR_OR_BOOL };
+enum QuickForm {
+    QUICK_NONE,
+    //relations; the '>' operator compares with >= and '>=' with >, as the generic code does
+    QUICK_FLOAT_LT_FLOAT, QUICK_FLOAT_LE_FLOAT, QUICK_FLOAT_GE_FLOAT, QUICK_FLOAT_GT_FLOAT,
+    QUICK_FLOAT_LT_INT, QUICK_FLOAT_LE_INT, QUICK_FLOAT_GE_INT, QUICK_FLOAT_GT_INT,
+    QUICK_INT_LT_FLOAT, QUICK_INT_LE_FLOAT, QUICK_INT_GE_FLOAT, QUICK_INT_GT_FLOAT,
+    QUICK_INT_LT_INT, QUICK_INT_LE_INT, QUICK_INT_GE_INT, QUICK_INT_GT_INT,
+    //equalities
+    QUICK_FLOAT_EQ_FLOAT, QUICK_FLOAT_NE_FLOAT, QUICK_FLOAT_EQ_INT, QUICK_FLOAT_NE_INT,
+    QUICK_INT_EQ_FLOAT, QUICK_INT_NE_FLOAT, QUICK_INT_EQ_INT, QUICK_INT_NE_INT,
+    //additions and subtractions
+    QUICK_INT_ADD_INT, QUICK_INT_SUB_INT, QUICK_INT_ADD_FLOAT, QUICK_INT_SUB_FLOAT,
+    QUICK_FLOAT_ADD_INT, QUICK_FLOAT_SUB_INT
+};
+struct QuickSite {
+    unsigned char left;     //operand kinds the form was specialized for
+    unsigned char right;
+    unsigned char form;
+};
+thread_local vector<QuickSite> quickSites;
+thread_local long long quickHits;
+thread_local long long quickMisses;
+thread_local long long quickDeopts;
+
+//checkpointing: the if-statements and while-loops currently executing, innermost last,
+//so that a run can be saved at a while-loop back-edge and resumed from there later
+struct ExecFrame {
+    int keyword;        //index of the 'if' or 'while' token
+    int start;          //while: index of the '(' the condition is parsed from
+    int end;            //while: index where the last iteration of the body ended
+    int body;           //index of the token just before the running body statement
+    bool cond;          //value of the condition the body was entered with
+    bool inElse;        //if: the else branch is the one running
+};
+thread_local vector<ExecFrame> execFrames;
+//frames read back from a checkpoint, and how many of them have been re-entered so far
+thread_local vector<ExecFrame> resumeFrames;
+thread_local int resumeDepth;
+const char CHECKPOINT_MAGIC[4] = { 'C', 'K', 'P', 'T' };
+const uint32_t CHECKPOINT_VERSION = 2;
+string checkpointFile;
+long long checkpointEvery = 1000000;
+uint64_t programHash;
+//back-edge count at which the run is next suspended, either to write a checkpoint or to
+//hand the thread back to the scheduler
+thread_local long long nextSuspend = LLONG_MAX;
+
+//execution trace: fixed-size records collected in a per-thread ring buffer that is
+//spilled into a memory-mapped file; the variable names follow the records at the end
+enum TraceKind { TRACE_ASSIGN, TRACE_ELEMENT, TRACE_IF, TRACE_WHILE };
+struct TraceRecord {
+    uint8_t kind;
+    uint8_t type;           //first letter of the value's type: 'i', 'f', 'b' or 'c'
+    uint16_t reserved;
+    uint32_t token;         //index of the statement's first token
+    uint32_t slot;          //variable written (assignments only)
+    int32_t index;          //element written (array elements only)
+    Multivalue value;       //value stored, or the branch condition
+} __attribute__((packed));
+struct TraceHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t recordCount;
+    uint64_t namesOffset;   //file offset of the slot names
+    uint32_t slotCount;
+    uint32_t reserved;
+};
+const char TRACE_MAGIC[4] = { 'C', 'T', 'R', 'C' };
+const uint32_t TRACE_VERSION = 1;
+const int TRACE_RING_RECORDS = 8192;
+bool tracing;
+thread_local TraceRecord *traceRing;
+thread_local int traceFill;
+thread_local vector<uint32_t> *traceSlotOfToken;    //slot + 1 for each id token, or 0
+thread_local vector<string> *traceNames;
+int traceFd = -1;
+unsigned char *traceMap;
+size_t traceMapped;
+uint64_t traceRecords;
+
+//collect-all-errors mode: an error ends only the declaration or statement it occurs in;
+//output is held in collectedOut until then so each message can be given its token index
+bool collectErrors;
+ostringstream collectedOut;
+vector<int> errorTokens;
+
+//parallel execution: index of the region this thread is running (-1 outside a parallel
+//run), and the first region that stopped with an error; regions after it are abandoned
+thread_local int parallelRegion = -1;
+int parallelFailed = INT_MAX;
+mutex parallelLock;
+const int PARALLEL_POLL_ITERATIONS = 1024;
+
+//scheduling: back-edges each program runs before giving up the thread (0 runs each
+//program to completion), and what is thrown to unwind a program when it yields
+long long scheduleSlice = 1000;
+bool scheduling;
+struct ProgramYield {};
 
-//function prototypes to allow for forward referencing
+//result cache: whether this run was a hit, and the hit/miss totals shared by every
+//process using the same cache directory (0 when no cache is in use)
+int cacheOutcome;
+long long cacheHits;
+long long cacheMisses;
+const int CACHE_HIT = 1;
+const int CACHE_MISS = 2;
+//part of every cache key; bump it whenever the interpreter's results or the entry format
+//change, so entries written by an older build are never replayed
+const int CACHE_VERSION = 3;
+//a cached run, like a parallel region, prints no message for a division by zero; the
+//trap is raised again once the output before it has been printed
+thread_local bool cachedRun;
+
+//for a parameter sweep, the names of the variables being bound and the initial
+//values for the instance currently running (both null for a normal run)
+thread_local vector<string> *bindingNames;
+thread_local vector<string> *bindingRow;
+
+//function prototypes to allow for forward referencing (conjunction and relation are
+//called as ::conjunction and ::relation, since C++17 adds std:: names that collide)
 void program ();
+void programHeader ();
+void programStatements ();
 void declarations ();
 void declaration ();
 void statements();
@@ -64,11 +380,71 @@ Heterogeneous relation ();
 Heterogeneous addition ();
 Heterogeneous term ();
 Heterogeneous factor();
+inline bool quickened (int site, int firstForm, int lastForm);
+inline bool runQuickened (int site, Heterogeneous &result, const Heterogeneous &temp);
+inline unsigned char operandKind (const string &type);
+void quicken (int site, unsigned char left, unsigned char right, int form);
 void printStmt();
 void ifStmt();
 void whileStmt();
 void returnStmt();
 void addSymbol();
+void allocateArray(const string &name, const Heterogeneous &entry);
+Multivalue &arrayElement(string &type, int &index);
+bool runElementLoop(int keyword);
+bool elementSum(int &pos, const string &index, vector<ElementOp> &program, vector<size_t> &lengths, int depth);
+bool elementOperand(int &pos, const string &index, vector<ElementOp> &program, vector<size_t> &lengths,
+    int depth);
+void elementBlock(ElementOpKind kind, uint32_t *__restrict left, const uint32_t *__restrict right);
+void elementFill(uint32_t *__restrict values, uint32_t first, uint32_t step);
+void applyBindings();
+bool loadInput(const string &argFile, bool sourceInput);
+void readTokenText(istream &input);
+bool loadTokenText(const string &argFile);
+bool decodeLiteral(const string &kind, const string &lexeme, Multivalue &value);
+void runOnThreads(int count, const function<void (int)> &work);
+void stop(int status);
+int runContained(const string &text, string &output);
+int runCaptured(string &output, bool prepass = true);
+bool isArrayType(const string &type);
+int runCached(const string &cacheDir, long long cacheLimit);
+int checkProgram(bool showCounts);
+int checkIncremental(const string &argFile, bool sourceInput, const string &stateFile);
+void serve(const string &socketPath, int workers);
+bool writeTokenImage(const string &imageFile);
+bool buildTokenImage(string &image);
+bool loadTokenImage(const string &imageFile);
+bool loadTokenImageBytes(const unsigned char *base, size_t size);
+void *mapFile(const string &file, size_t &size);
+void checkBudgets();
+void reportStats();
+void recordPhase(const string &name);
+void measureMemory();
+void reportMemStats();
+size_t tokenStorageBytes();
+bool runSnapshot(const string &snapshotFile, const string &argFile, bool sourceInput);
+void benchmarkLoad(const string &textFile, const string &imageFile, bool sourceInput);
+bool lexSource(const string &text, vector<uint32_t> *spans = 0);
+void eliminateDeadStores();
+void writeCheckpoint();
+void enterFrames();
+void suspendRun();
+int runSchedule(const vector<string> &files, bool sourceInput);
+int runParallel(int workers);
+int runCollectingErrors();
+void runRecovering(bool isStatement);
+void noteError();
+bool startTrace(const string &traceFile);
+void traceBranch(TraceKind kind, int token, bool taken);
+void traceStore(TraceKind kind, int token, int index, const string &type, Multivalue value);
+void spillTrace();
+void finishTrace();
+int decodeTrace(const string &traceFile);
+ExecFrame *resumeFrame(int keyword);
+bool resumeCheckpoint(const string &resumeFile);
+uint64_t tokenStreamHash();
+void appendField(string &record, const string &text);
+bool readField(const char *&field, const char *end, string &text);
 
 
 
@@ -80,35 +456,450 @@ void addSymbol();
 int main ( int argc, char *argv[] ) {
     
 
-    //use ifstream to read in file
-    ifstream input;
-    
+    //options come before the input file(s):
+    //  --sweep <file>     run the program once per row of initial variable bindings
+    //  --source           the input file is CLite source rather than tokens and lexemes
+    //  --compile-tokens   write the input as a binary token image: in.txt out.ctok
+    //  --bench-load       time loading in.txt as text against loading out.ctok
+    //  --snapshot <file>  start from the state saved before the first statement, saving it
+    //                     again if it is stale (--image is accepted as the older name)
+    //  --max-steps <n>    stop with status 3 after n statements and loop iterations
+    //  --max-ms <n>       stop with status 4 after n milliseconds of wall-clock time
+    //  --stats            print steps, CPU time and peak memory to stderr at exit
+    //  --serve            run framed programs from stdin (or --socket <path>) until EOF
+    //  --workers <n>      number of programs the server (or --parallel, --sweep) runs at once
+    //  --cache <dir>      reuse results of earlier runs of an identical token stream
+    //  --cache-mb <n>     size bound for the cache directory (default 64 MB)
+    //  --check            only type check the program, reporting every type error
+    //  --incremental <f>  type check, reusing per-statement results saved in file f
+    //  --checkpoint <f>   save the run's state to f at while-loop back-edges
+    //  --checkpoint-every <n>  back-edges between checkpoints (default 1000000)
+    //  --resume <f>       continue from the checkpoint in f (from the start if none)
+    //  --schedule         interleave every input file on one thread, time-sliced
+    //  --slice <n>        back-edges a scheduled program runs before yielding (1000)
+    //  --load-threads <n> threads used to load a token text file (default one per core)
+    //  --trace <f>        record every assignment and branch outcome in binary file f
+    //  --decode-trace <f> print the trace recorded in file f
+    //  --parallel         run independent top-level statements on --workers threads
+    //  --all-errors       report every error (recovering at ';' and '}') and exit 1
+    //  --check-threads <n> threads used by --check (default one per core)
+    //  --mem-stats        print the bytes used by each part of the interpreter at exit
+    //  --mem-json <f>     also write those figures to file f as JSON
+    string sweepFile;
+    string snapshotFile;
+    bool sourceInput = false;
+    bool compileTokens = false;
+    bool benchLoad = false;
+    bool serveMode = false;
+    string socketPath;
+    string cacheDir;
+    bool checkOnly = false;
+    bool parallel = false;
+    string stateFile;
+    string resumeFile;
+    string traceFile;
+    string decodeFile;
+    long long cacheLimit = 64LL << 20;
+    int workers = max(1u, thread::hardware_concurrency());
+    vector<string> files;
+    for ( int argi = 1; argi < argc; argi++ ) {
+        string option = argv[argi];
+        if ( option == "--sweep" && argi + 1 < argc ) {
+            sweepFile = argv[++argi];
+        }
+        else if ( option == "--source" ) {
+            sourceInput = true;
+        }
+        else if ( option == "--compile-tokens" ) {
+            compileTokens = true;
+        }
+        else if ( option == "--bench-load" ) {
+            benchLoad = true;
+        }
+        else if ( ( option == "--snapshot" || option == "--image" ) && argi + 1 < argc ) {
+            snapshotFile = argv[++argi];
+        }
+        else if ( option == "--max-steps" && argi + 1 < argc ) {
+            maxSteps = atoll(argv[++argi]);
+        }
+        else if ( option == "--max-ms" && argi + 1 < argc ) {
+            maxMillis = atof(argv[++argi]);
+        }
+        else if ( option == "--stats" ) {
+            showStats = true;
+            atexit(reportStats);
+        }
+        else if ( option == "--mem-stats" || ( option == "--mem-json" && argi + 1 < argc ) ) {
+            if ( option == "--mem-json" ) {
+                memJsonFile = argv[++argi];
+            }
+            if ( !memStats ) {
+                atexit(reportMemStats);
+            }
+            memStats = true;
+        }
+        else if ( option == "--serve" ) {
+            serveMode = true;
+        }
+        else if ( option == "--socket" && argi + 1 < argc ) {
+            socketPath = argv[++argi];
+        }
+        else if ( option == "--workers" && argi + 1 < argc ) {
+            workers = max(1, atoi(argv[++argi]));
+        }
+        else if ( option == "--cache" && argi + 1 < argc ) {
+            cacheDir = argv[++argi];
+        }
+        else if ( option == "--cache-mb" && argi + 1 < argc ) {
+            cacheLimit = atoll(argv[++argi]) << 20;
+        }
+        else if ( option == "--checkpoint" && argi + 1 < argc ) {
+            checkpointFile = argv[++argi];
+        }
+        else if ( option == "--checkpoint-every" && argi + 1 < argc ) {
+            checkpointEvery = max(1LL, atoll(argv[++argi]));
+        }
+        else if ( option == "--resume" && argi + 1 < argc ) {
+            resumeFile = argv[++argi];
+        }
+        else if ( option == "--schedule" ) {
+            scheduling = true;
+        }
+        else if ( option == "--slice" && argi + 1 < argc ) {
+            scheduleSlice = max(0LL, atoll(argv[++argi]));
+        }
+        else if ( option == "--load-threads" && argi + 1 < argc ) {
+            loadThreads = max(1, atoi(argv[++argi]));
+        }
+        else if ( option == "--trace" && argi + 1 < argc ) {
+            traceFile = argv[++argi];
+        }
+        else if ( option == "--decode-trace" && argi + 1 < argc ) {
+            decodeFile = argv[++argi];
+        }
+        else if ( option == "--all-errors" ) {
+            collectErrors = true;
+        }
+        else if ( option == "--parallel" ) {
+            parallel = true;
+        }
+        else if ( option == "--check" ) {
+            checkOnly = true;
+        }
+        else if ( option == "--check-threads" && argi + 1 < argc ) {
+            checkThreads = max(1, atoi(argv[++argi]));
+        }
+        else if ( option == "--incremental" && argi + 1 < argc ) {
+            checkOnly = true;
+            stateFile = argv[++argi];
+        }
+        else if ( option.compare(0, 2, "--") == 0 ) {
+            return 0;
+        }
+        else {
+            files.push_back( option );
+        }
+    }
+
+    //the server takes its programs from stdin or a socket instead of a file
+    startTime = chrono::steady_clock::now();
+    if ( serveMode ) {
+        if ( !files.empty() ) return 0;
+        serve(socketPath, workers);
+        return 0;
+    }
+
+    //decoding a trace needs no program
+    if ( !decodeFile.empty() ) {
+        return decodeTrace(decodeFile);
+    }
+
+    //the scheduler loads and runs every input file itself
+    if ( scheduling ) {
+        if ( files.empty() ) return 0;
+        return runSchedule(files, sourceInput);
+    }
+
     //check for correct number of arguments
-    if ( argc != 2 ) return 0;
+    if ( files.size() != ( compileTokens || benchLoad ? 2 : 1 ) ) return 0;
     
     //read in input file
-    string argFile = argv[1];
+    string argFile = files[0];
+    lexemes = new vector<string>;
+    tokens = new vector<string>;
+
+    //a cache entry holds only the output, status and final variables of a plain
+    //sequential run, so modes that would change or extend that are refused
+    if ( !cacheDir.empty() && ( parallel || !checkpointFile.empty() || !resumeFile.empty() ||
+        !traceFile.empty() || !sweepFile.empty() || collectErrors || checkOnly ) ) {
+        cout << "Error: --cache cannot be combined with --parallel, --checkpoint, --resume, "
+             << "--trace, --sweep, --all-errors or --check" << endl;
+        return 0;
+    }
+
+    //a snapshot replaces loading, the dead-store pass and the declarations
+    if ( !snapshotFile.empty() ) {
+        if ( !sweepFile.empty() || compileTokens || benchLoad ) {
+            cout << "Error: --snapshot cannot be combined with other modes" << endl;
+            return 0;
+        }
+        runSnapshot(snapshotFile, argFile, sourceInput);
+        return 0;
+    }
+
+    //an incremental check reads its input itself, so that only an edited region is lexed
+    if ( checkOnly && !stateFile.empty() && sweepFile.empty() && !compileTokens && !benchLoad ) {
+        memFinalPhase = "check";
+        int status = checkIncremental(argFile, sourceInput, stateFile);
+        measureMemory();
+        return status;
+    }
+
+    if ( !loadInput(argFile, sourceInput) ) {
+        return 0;
+    }
+    recordPhase("load");
+
+    //write the token image and stop without running the program
+    if ( compileTokens ) {
+        if ( !writeTokenImage(files[1]) ) {
+            cout << "Error: could not write token image " << files[1] << endl;
+        }
+        return 0;
+    }
+    if ( benchLoad ) {
+        benchmarkLoad(argFile, files[1], sourceInput);
+        return 0;
+    }
+    
+    //read the sweep's header line of variable names and its rows of initial values
+    vector< vector<string> > sweepRows;
+    if ( !sweepFile.empty() ) {
+        ifstream sweep (sweepFile.c_str());
+        if ( !sweep.is_open() ) {
+            cout << "Error: could not open bindings file " << sweepFile << endl;
+            return 0;
+        }
+        string line;
+        string word;
+        bindingNames = new vector<string>;
+        while ( getline(sweep, line) ) {
+            istringstream fields (line);
+            vector<string> row;
+            while ( fields >> word ) {
+                row.push_back( word );
+            }
+            if ( row.empty() ) {
+                continue;
+            }
+            if ( bindingNames->empty() ) {
+                *bindingNames = row;
+            }
+            else if ( row.size() != bindingNames->size() ) {
+                cout << "Error: bindings row " << sweepRows.size() + 1 << " has " << row.size()
+                     << " values for " << bindingNames->size() << " variables" << endl;
+                return 0;
+            }
+            else {
+                sweepRows.push_back( row );
+            }
+        }
+    }
+
+    //a check-only run reports type errors without executing anything
+    int status = 0;
+    if ( checkOnly ) {
+        memFinalPhase = "check";
+        status = checkProgram(showStats);
+    }
+
+    //collecting every error runs the program once, recovering after each error
+    else if ( collectErrors && sweepFile.empty() ) {
+        status = runCollectingErrors();
+    }
+
+    //a cached run replays an earlier result for the same tokens without parsing them
+    else if ( !cacheDir.empty() && sweepFile.empty() ) {
+        status = runCached(cacheDir, cacheLimit);
+    }
+
+    //initialize index value and begin parsing by calling program method
+    else if ( sweepFile.empty() ) {
+        //remove assignments and declarations that can never affect the program's output
+        eliminateDeadStores();
+        if ( !checkpointFile.empty() || !resumeFile.empty() ) {
+            programHash = tokenStreamHash();
+            nextSuspend = checkpointFile.empty() ? LLONG_MAX : checkpointEvery;
+        }
+        if ( !traceFile.empty() && !startTrace(traceFile) ) {
+            cout << "Error: could not create trace file " << traceFile << endl;
+            return 0;
+        }
+        if ( !resumeFile.empty() && resumeCheckpoint(resumeFile) ) {
+            //the next checkpoint is due a full interval after the restored back-edge count
+            if ( !checkpointFile.empty() ) {
+                nextSuspend = loopIterations + checkpointEvery;
+            }
+            programStatements();
+        }
+        //budgets, checkpoints and traces follow the sequential order of execution, so a
+        //run that uses any of them is never split up
+        else if ( parallel && maxSteps == LLONG_MAX && maxMillis == 0 && checkpointFile.empty() &&
+            traceFile.empty() ) {
+            status = runParallel(workers);
+        }
+        else {
+            currToken = -1;
+            program();
+        }
+        //errors and budget stops exit before this point, so the program has finished and
+        //its last checkpoint must not be resumed from again
+        if ( !checkpointFile.empty() ) {
+            remove(checkpointFile.c_str());
+        }
+    }
+    //for a sweep, run every instance from a fresh symbol table, collecting each instance's
+    //print output under a heading with its status; an error or budget stop ends only the
+    //instance it happens in.  The instances are run in batches on --workers threads that
+    //share the tokens (each instance still runs alone, not in lockstep with the others),
+    //and their output is printed in row order once every instance has finished
+    else {
+        eliminateDeadStores();
+        chrono::steady_clock::time_point sweepStart = startTime;
+        vector<string> outputs (sweepRows.size());
+        vector<int> statuses (sweepRows.size());
+        vector<string> *sharedTokens = tokens;
+        vector<string> *sharedLexemes = lexemes;
+        vector<DecodedLiteral> *sharedLiterals = tokenLiterals;
+        vector<string> *sharedNames = bindingNames;
+        int nextRow = 0;
+        mutex countLock;
+        long long sweepSteps = 0;
+        long long sweepIterations = 0;
+        long long sweepHits = 0;
+        long long sweepMisses = 0;
+        long long sweepDeopts = 0;
+        runOnThreads(min(workers, max(1, (int) sweepRows.size())), [&] (int worker) {
+            if ( worker != 0 ) {
+                tokens = sharedTokens;
+                lexemes = sharedLexemes;
+                tokenLiterals = sharedLiterals;
+                bindingNames = sharedNames;
+            }
+            //runCaptured gives each instance the full step and time budget, so its counters
+            //are added up here for --stats
+            long long steps = 0;
+            long long iterations = 0;
+            while ( true ) {
+                int i;
+                {
+                    lock_guard<mutex> taking (countLock);
+                    i = nextRow++;
+                }
+                if ( i >= (int) sweepRows.size() ) {
+                    break;
+                }
+                bindingRow = &sweepRows[i];
+                statuses[i] = runCaptured(outputs[i], false);
+                steps += stepCount;
+                iterations += loopIterations;
+            }
+            bindingRow = 0;
+            lock_guard<mutex> counting (countLock);
+            sweepSteps += steps;
+            sweepIterations += iterations;
+            sweepHits += quickHits;
+            sweepMisses += quickMisses;
+            sweepDeopts += quickDeopts;
+            if ( worker != 0 ) {
+                tokens = 0;
+                lexemes = 0;
+                tokenLiterals = 0;
+                bindingNames = 0;
+            }
+        });
+        for ( int i = 0; i < (int) sweepRows.size(); i++ ) {
+            cout << "instance " << i + 1 << ", status " << statuses[i] << ":" << endl << outputs[i];
+            if ( status == 0 ) {
+                status = statuses[i];
+            }
+        }
+        stepCount = sweepSteps;
+        loopIterations = sweepIterations;
+        quickHits = sweepHits;
+        quickMisses = sweepMisses;
+        quickDeopts = sweepDeopts;
+        startTime = sweepStart;
+        delete bindingNames;
+        bindingNames = 0;
+    }
+      
+    //free memory
+    measureMemory();
+    delete lexemes;
+    delete tokens;
+    delete tokenLiterals;
+    lexemes = 0;
+    tokens = 0;
+    tokenLiterals = 0;
+    return status;
+}
+
+/*
+ *===========================================
+ *  LOADING FCNS -- fill the token and lexeme
+ *                  vectors from an input file
+ *===========================================
+ */
+
+bool loadInput (const string &argFile, bool sourceInput) {
+
+    //use ifstream to read in file
+    ifstream input;
     input.open(argFile.c_str());
     
     //check for non-existent input file
     if ( !input.is_open() ) {
-        cout << "Error: could not open input file " << argFile << endl;
-        return 0;
+        *out << "Error: could not open input file " << argFile << endl;
+        return false;
     }
     
     //check to make sure input file is not empty
     else if ( input.peek() == ifstream::traits_type::eof() ) {
         input.close();
         input.clear();
-        cout << "Error: empty input file " << argFile << endl;
-        return 0;
+        *out << "Error: empty input file " << argFile << endl;
+        return false;
+    }
+
+    //a compiled token image is recognized by its magic bytes
+    char magic[4] = { 0, 0, 0, 0 };
+    input.read(magic, 4);
+    input.clear();
+    input.seekg(0);
+    if ( memcmp(magic, TOKEN_IMAGE_MAGIC, 4) == 0 ) {
+        input.close();
+        return loadTokenImage(argFile);
     }
+
+    //for source input, read the whole file at once and split it into tokens directly
+    if ( sourceInput ) {
+        stringstream text;
+        text << input.rdbuf();
+        return lexSource(text.str());
+    }
+    
+    //close the input file and read it again through a mapping, split across threads
+    input.close();
+    return loadTokenText(argFile);
+}
+
+
+void readTokenText (istream &input) {
     
     //used to read in and store input file data
     int counter = 0;
     string word;
-    lexemes = new vector<string>;
-    tokens = new vector<string>;
 
     //read in tokens and lexemes from input file and store them in respective vectors
     while ( input >> word ) {
@@ -121,100 +912,600 @@ int main ( int argc, char *argv[] ) {
         }
         counter++;
     }
-    
-    //initialize index value and begin parsing by calling program method
-    currToken = -1;
-    program();
-      
-    //free memory
-    delete lexemes;
-    delete tokens;
-    lexemes = 0;
-    tokens = 0;
-      
-    //close the input file
-    input.close();
 }
 
-/*
- *===================================================================
- *  PROGRAM FCN -- consume tokens at start and end of a program, 
- *                 call fcns to consume other tokens in declarations
- *                 and statements
- *===================================================================
- */
 
-void program () {
-    
+//the characters operator>> treats as separators in the default locale
+inline bool isWordSpace (char c) {
+    return c == ' ' || ( c >= '\t' && c <= '\r' );
+}
 
-    //advance index to first element in token vector and begin by consuming a type
-    string programToken = tokens->at(++currToken);
-    if ( programToken != "type" ) {
-        cout << "Error: 'type' token missing for main function return value" << endl;
-        exit(0);
+
+bool loadTokenText (const string &argFile) {
+
+    size_t size = 0;
+    void *mapped = mapFile(argFile, size);
+    if ( mapped == 0 ) {
+        *out << "Error: could not read input file " << argFile << endl;
+        return false;
     }
-    //consume 'main' token
-    programToken = tokens->at(++currToken);
-    if ( programToken != "main" ) {
-        cout << "Error: 'main' token missing" <<endl;
-        exit(0);
+    const char *base = (const char *) mapped;
+    const char *end = base + size;
+
+    //cut the file into one chunk per thread, moving each cut forward to the next
+    //whitespace character so that no word is split between two chunks
+    int chunks = max(1, (int) min((size_t) loadThreads, size / LOAD_CHUNK_MIN));
+    vector<const char *> bounds (chunks + 1, end);
+    bounds[0] = base;
+    for ( int c = 1; c < chunks; c++ ) {
+        const char *cut = max(bounds[c - 1], base + size / chunks * c);
+        while ( cut < end && !isWordSpace(*cut) ) {
+            cut++;
+        }
+        bounds[c] = cut;
     }
-    //consume '(' token
-    programToken = tokens->at(++currToken);
-    if ( programToken != "(" ) {
-        cout << "Error: '(' token missing in main function" <<endl;
-        exit(0);
+
+    //first pass: count the words in every chunk, each on its own thread
+    vector<size_t> first (chunks + 1, 0);
+    runOnThreads(chunks, [&] (int c) {
+        size_t words = 0;
+        for ( const char *p = bounds[c]; p < bounds[c + 1]; p++ ) {
+            words += !isWordSpace(*p) && ( p == bounds[c] || isWordSpace(p[-1]) );
+        }
+        first[c + 1] = words;
+    });
+
+    //a prefix sum of the counts gives each chunk's first global word index; even words
+    //are tokens and odd words are lexemes, as in readTokenText
+    for ( int c = 0; c < chunks; c++ ) {
+        first[c + 1] += first[c];
     }
-    //consume ')' token
-    programToken = tokens->at(++currToken);
-    if ( programToken != ")" ) {
-        cout << "Error: ')' token missing in main function" <<endl;
-        exit(0);
+    size_t count = first[chunks];
+    //(the vectors are reached through references because the globals are thread_local)
+    vector<string> &tokenWords = *tokens;
+    vector<string> &lexemeWords = *lexemes;
+    tokenWords.clear();
+    lexemeWords.clear();
+    tokenWords.resize(( count + 1 ) / 2);
+    lexemeWords.resize(count / 2);
+    delete tokenLiterals;
+    tokenLiterals = new vector<DecodedLiteral> (lexemeWords.size());
+    vector<DecodedLiteral> &decoded = *tokenLiterals;
+
+    //second pass: store every word straight into its slot and decode numeric literals
+    //ahead of factor(); a lexeme whose token ended the previous chunk is decoded below
+    runOnThreads(chunks, [&] (int c) {
+        size_t g = first[c];
+        const char *p = bounds[c];
+        const char *chunkEnd = bounds[c + 1];
+        while ( true ) {
+            while ( p < chunkEnd && isWordSpace(*p) ) {
+                p++;
+            }
+            if ( p == chunkEnd ) {
+                break;
+            }
+            const char *word = p;
+            while ( p < chunkEnd && !isWordSpace(*p) ) {
+                p++;
+            }
+            if ( g % 2 == 0 ) {
+                tokenWords[g / 2].assign(word, p - word);
+            }
+            else {
+                lexemeWords[g / 2].assign(word, p - word);
+                decoded[g / 2].value.iValue = 0;
+                if ( g > first[c] ) {
+                    decoded[g / 2].decoded = decodeLiteral(tokenWords[g / 2], lexemeWords[g / 2],
+                        decoded[g / 2].value);
+                }
+            }
+            g++;
+        }
+    });
+    for ( int c = 1; c < chunks; c++ ) {
+        size_t g = first[c];
+        if ( g % 2 == 1 && g < count ) {
+            decoded[g / 2].decoded = decodeLiteral(tokenWords[g / 2], lexemeWords[g / 2],
+                decoded[g / 2].value);
+        }
     }
-    //consume '{' token
-    programToken = tokens->at(++currToken);
-    if ( programToken != "{" ) {
-        cout << "Error: '{' token missing at beginning of main function" <<endl;
-        exit(0);
+    munmap(mapped, size);
+    return true;
+}
+
+
+void runOnThreads (int count, const function<void (int)> &work) {
+
+    //work(0) runs on the calling thread and the rest on threads of their own
+    vector<thread> workers;
+    for ( int i = 1; i < count; i++ ) {
+        workers.push_back(thread(work, i));
     }
-    
-    //parse for all declarations, then parse for all statements
-    declarations();
-    statements();
-    
-    //consume '}' token for end of main function
-    programToken = tokens->at(++currToken);
-    if ( programToken != "}" ) {
-        cout << "Error: '}' token missing at end of main function" <<endl;
-        exit(0);
+    work(0);
+    for ( int i = 0; i < (int) workers.size(); i++ ) {
+        workers[i].join();
     }
 }
 
-/* 
- *=======================================
- *  FCNS FOR DECLARATIONS AND STATEMENTS
- *=======================================
- */ 
 
+bool decodeLiteral (const string &kind, const string &lexeme, Multivalue &value) {
 
-void declarations () {
-    //parse all declarations first
-    while ( currToken < tokens->size() - 1 ) {
-        //if the next token is not 'type', it must not be the start of a new declaration
-        string typeToken = tokens->at(++currToken);
-        if ( typeToken != "type" ) {
-            currToken--;
-            return;
+    //literals that fail to decode are left for factor() to report
+    try {
+        if ( kind == "intLiteral" ) {
+            value.iValue = stoi(lexeme);
+            return true;
         }
-        declaration();
+        else if ( kind == "floatLiteral" ) {
+            value.fValue = stof(lexeme);
+            return true;
+        }
+    }
+    catch ( ... ) {
     }
+    return false;
 }
 
 
-void declaration () {
-    
-    //save the index of the last type so we can refer back to that type if there is a
-    //string of comma-separated declarations
+//FNV-1a hash used as the token image checksum
+uint64_t checksum (const unsigned char *data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+    for ( size_t i = 0; i < size; i++ ) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+bool writeTokenImage (const string &imageFile) {
+
+    string image;
+    if ( !buildTokenImage(image) ) {
+        return false;
+    }
+    ofstream imageOut (imageFile.c_str(), ios::binary | ios::trunc);
+    imageOut.write(image.data(), image.size());
+    return imageOut.good();
+}
+
+
+bool buildTokenImage (string &image) {
+
+    //intern every distinct kind and lexeme string into one pool
+    map<string, uint32_t> poolIds;
+    vector<const string *> pool;
+    vector<uint32_t> kindIds;
+    map<string, unsigned char> kindNumbers;
+    vector<unsigned char> kinds;
+    vector<uint32_t> lexemeIds;
+    vector<Multivalue> values;
+    vector<unsigned char> decoded;
+
+    for ( int i = 0; i < (int) tokens->size(); i++ ) {
+        const string &kind = tokens->at(i);
+        if ( kindNumbers.count(kind) == 0 ) {
+            if ( kindNumbers.size() == 256 ) {
+                *out << "Error: more than 256 distinct token kinds" << endl;
+                return false;
+            }
+            if ( poolIds.count(kind) == 0 ) {
+                poolIds[kind] = pool.size();
+                pool.push_back(&kind);
+            }
+            kindNumbers[kind] = kindIds.size();
+            kindIds.push_back(poolIds[kind]);
+        }
+        kinds.push_back(kindNumbers[kind]);
+    }
+    for ( int i = 0; i < (int) lexemes->size(); i++ ) {
+        const string &lexeme = lexemes->at(i);
+        if ( poolIds.count(lexeme) == 0 ) {
+            poolIds[lexeme] = pool.size();
+            pool.push_back(&lexeme);
+        }
+        lexemeIds.push_back(poolIds[lexeme]);
+
+        //decode numeric literals now so factor() does not have to on every evaluation
+        Multivalue value;
+        value.iValue = 0;
+        unsigned char ok = decodeLiteral(tokens->at(i), lexeme, value) ? 1 : 0;
+        values.push_back(value);
+        decoded.push_back(ok);
+    }
+    vector<uint32_t> poolOffsets;
+    string poolBytes;
+    for ( int i = 0; i < (int) pool.size(); i++ ) {
+        poolOffsets.push_back(poolBytes.size());
+        poolBytes += *pool[i];
+    }
+    poolOffsets.push_back(poolBytes.size());
+
+    //lay out the word-sized arrays first so that every array stays aligned
+    string payload;
+    payload.append((const char *) kindIds.data(), kindIds.size() * sizeof(uint32_t));
+    payload.append((const char *) lexemeIds.data(), lexemeIds.size() * sizeof(uint32_t));
+    payload.append((const char *) values.data(), values.size() * sizeof(Multivalue));
+    payload.append((const char *) poolOffsets.data(), poolOffsets.size() * sizeof(uint32_t));
+    payload.append((const char *) kinds.data(), kinds.size());
+    payload.append((const char *) decoded.data(), decoded.size());
+    payload += poolBytes;
+
+    TokenImageHeader header;
+    memcpy(header.magic, TOKEN_IMAGE_MAGIC, 4);
+    header.version = TOKEN_IMAGE_VERSION;
+    header.tokenCount = tokens->size();
+    header.lexemeCount = lexemes->size();
+    header.kindCount = kindIds.size();
+    header.poolCount = pool.size();
+    header.poolBytes = poolBytes.size();
+    header.reserved = 0;
+    header.checksum = checksum((const unsigned char *) payload.data(), payload.size());
+
+    image.assign((const char *) &header, sizeof(header));
+    image += payload;
+    return true;
+}
+
+
+bool loadTokenImage (const string &imageFile) {
+
+    //map the whole image read-only; the arrays are used in place
+    size_t size;
+    void *mapped = mapFile(imageFile, size);
+    if ( mapped == 0 ) {
+        *out << "Error: could not open input file " << imageFile << endl;
+        return false;
+    }
+    bool loaded = loadTokenImageBytes((const unsigned char *) mapped, size);
+    munmap(mapped, size);
+    if ( !loaded ) {
+        *out << "Error: corrupt or unsupported token image " << imageFile << endl;
+    }
+    return loaded;
+}
+
+
+//map a whole file read-only, returning null if it cannot be opened or is empty
+void *mapFile (const string &file, size_t &size) {
+    int fd = open(file.c_str(), O_RDONLY);
+    struct stat info;
+    if ( fd < 0 ) {
+        return 0;
+    }
+    if ( fstat(fd, &info) != 0 || info.st_size == 0 ) {
+        close(fd);
+        return 0;
+    }
+    size = info.st_size;
+    void *mapped = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return mapped == MAP_FAILED ? 0 : mapped;
+}
+
+
+bool loadTokenImageBytes (const unsigned char *base, size_t size) {
+
+    //validate the header: version, array sizes against the file size, then checksum
+    TokenImageHeader header;
+    bool valid = size >= sizeof(header);
+    if ( valid ) {
+        memcpy(&header, base, sizeof(header));
+        uint64_t expected = sizeof(header) + (uint64_t) header.kindCount * 4 +
+            (uint64_t) header.lexemeCount * ( 4 + sizeof(Multivalue) + 1 ) +
+            ( (uint64_t) header.poolCount + 1 ) * 4 + header.tokenCount + header.poolBytes;
+        valid = header.version == TOKEN_IMAGE_VERSION && expected == size &&
+            header.lexemeCount <= header.tokenCount &&
+            checksum(base + sizeof(header), size - sizeof(header)) == header.checksum;
+    }
+    if ( !valid ) {
+        return false;
+    }
+
+    const uint32_t *kindIds = (const uint32_t *) ( base + sizeof(header) );
+    const uint32_t *lexemeIds = kindIds + header.kindCount;
+    const Multivalue *values = (const Multivalue *) ( lexemeIds + header.lexemeCount );
+    const uint32_t *poolOffsets = (const uint32_t *) ( values + header.lexemeCount );
+    const unsigned char *kinds = (const unsigned char *) ( poolOffsets + header.poolCount + 1 );
+    const unsigned char *decoded = kinds + header.tokenCount;
+    const char *poolBytes = (const char *) ( decoded + header.lexemeCount );
+
+    //materialize each pooled string once, then fill the vectors by copying from the pool
+    vector<string> pool (header.poolCount);
+    for ( uint32_t i = 0; i < header.poolCount; i++ ) {
+        if ( poolOffsets[i] > poolOffsets[i + 1] || poolOffsets[i + 1] > header.poolBytes ) {
+            return false;
+        }
+        pool[i].assign(poolBytes + poolOffsets[i], poolOffsets[i + 1] - poolOffsets[i]);
+    }
+
+    //every kind and pool id must be in range before anything is indexed with it
+    for ( uint32_t k = 0; k < header.kindCount; k++ ) {
+        if ( kindIds[k] >= header.poolCount ) {
+            return false;
+        }
+    }
+    for ( uint32_t i = 0; i < header.tokenCount; i++ ) {
+        if ( kinds[i] >= header.kindCount ) {
+            return false;
+        }
+    }
+    for ( uint32_t i = 0; i < header.lexemeCount; i++ ) {
+        if ( lexemeIds[i] >= header.poolCount ) {
+            return false;
+        }
+    }
+    tokens->reserve(header.tokenCount);
+    lexemes->reserve(header.lexemeCount);
+    delete tokenLiterals;
+    tokenLiterals = new vector<DecodedLiteral> (header.lexemeCount);
+    for ( uint32_t i = 0; i < header.tokenCount; i++ ) {
+        tokens->push_back( pool[kindIds[kinds[i]]] );
+    }
+    for ( uint32_t i = 0; i < header.lexemeCount; i++ ) {
+        lexemes->push_back( pool[lexemeIds[i]] );
+        (*tokenLiterals)[i].value = values[i];
+        (*tokenLiterals)[i].decoded = decoded[i] != 0;
+    }
+    return true;
+}
+
+
+void benchmarkLoad (const string &textFile, const string &imageFile, bool sourceInput) {
+
+    //make sure the image is current, then time repeated loads of each format
+    if ( !writeTokenImage(imageFile) ) {
+        *out << "Error: could not write token image " << imageFile << endl;
+        return;
+    }
+    size_t count = tokens->size();
+    const int rounds = 10;
+    for ( int format = 0; format < 2; format++ ) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for ( int round = 0; round < rounds; round++ ) {
+            tokens->clear();
+            lexemes->clear();
+            delete tokenLiterals;
+            tokenLiterals = 0;
+            if ( format == 0 )
+                loadInput(textFile, sourceInput);
+            else
+                loadTokenImage(imageFile);
+        }
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / rounds;
+        *out << ( format == 0 ? "text " : "image" ) << "  " << count << " tokens  " << ms
+             << " ms/load  " << ms * 1e6 / max(count, (size_t) 1) << " ns/token  "
+             << (double) tokenStorageBytes() / max(count, (size_t) 1) << " bytes/token" << endl;
+    }
+}
+
+bool runSnapshot (const string &snapshotFile, const string &argFile, bool sourceInput) {
+
+    //the snapshot is only current if it was built from exactly these input bytes
+    size_t sourceSize;
+    void *source = mapFile(argFile, sourceSize);
+    if ( source == 0 ) {
+        //let the normal loader report the missing or empty file
+        return loadInput(argFile, sourceInput);
+    }
+    uint64_t sourceHash = checksum((const unsigned char *) source, sourceSize);
+    munmap(source, sourceSize);
+
+    //validate the snapshot by magic, version, checksum and source hash
+    size_t size = 0;
+    void *mapped = mapFile(snapshotFile, size);
+    const unsigned char *base = (const unsigned char *) mapped;
+    SnapshotHeader header;
+    bool valid = mapped != 0 && size >= sizeof(header);
+    if ( valid ) {
+        memcpy(&header, base, sizeof(header));
+        valid = memcmp(header.magic, SNAPSHOT_MAGIC, 4) == 0 &&
+            header.version == SNAPSHOT_VERSION && header.sourceHash == sourceHash &&
+            header.sourceInput == ( sourceInput ? 1u : 0u ) &&
+            sizeof(header) + (uint64_t) header.symbolBytes <= size &&
+            checksum(base + sizeof(header), size - sizeof(header)) == header.checksum;
+    }
+
+    //install the symbol slots exactly as declarations() left them
+    const unsigned char *field = base + sizeof(header);
+    const unsigned char *symbolsEnd = field + ( valid ? header.symbolBytes : 0 );
+    for ( uint32_t i = 0; valid && i < header.symbolCount; i++ ) {
+        string parts[2];
+        for ( int part = 0; part < 2 && valid; part++ ) {
+            uint32_t length;
+            valid = field + sizeof(length) <= symbolsEnd;
+            if ( valid ) {
+                memcpy(&length, field, sizeof(length));
+                field += sizeof(length);
+                valid = field + length <= symbolsEnd;
+            }
+            if ( valid ) {
+                parts[part].assign((const char *) field, length);
+                field += length;
+            }
+        }
+        Multivalue value;
+        valid = valid && field + sizeof(value) <= symbolsEnd;
+        if ( valid ) {
+            memcpy(&value, field, sizeof(value));
+            field += sizeof(value);
+            symTable[parts[0]] = Heterogeneous(parts[1], value);
+            if ( parts[1].size() > 2 && parts[1].compare(parts[1].size() - 2, 2, "[]") == 0 ) {
+                valid = value.iValue > 0 && value.iValue <= MAX_ARRAY_LENGTH;
+                if ( valid ) {
+                    allocateArray(parts[0], symTable[parts[0]]);
+                }
+            }
+        }
+    }
+    valid = valid && loadTokenImageBytes(symbolsEnd, size - sizeof(header) - header.symbolBytes) &&
+        header.firstStatement <= tokens->size();
+    if ( mapped != 0 ) {
+        munmap(mapped, size);
+    }
+    if ( valid ) {
+        currToken = header.firstStatement - 1;
+        programStatements();
+        return true;
+    }
+
+    //the snapshot is missing or stale: rebuild it from the input and run from the rebuilt state
+    symTable.clear();
+    arrayTable.clear();
+    tokens->clear();
+    lexemes->clear();
+    delete tokenLiterals;
+    tokenLiterals = 0;
+    if ( !loadInput(argFile, sourceInput) ) {
+        return false;
+    }
+    eliminateDeadStores();
+    currToken = -1;
+    programHeader();
+
+    string symbols;
+    for ( map<string, Heterogeneous>::iterator entry = symTable.begin(); entry != symTable.end(); ++entry ) {
+        uint32_t length = entry->first.size();
+        symbols.append((const char *) &length, sizeof(length));
+        symbols += entry->first;
+        length = entry->second.type.size();
+        symbols.append((const char *) &length, sizeof(length));
+        symbols += entry->second.type;
+        symbols.append((const char *) &entry->second.value, sizeof(Multivalue));
+    }
+    string payload;
+    if ( buildTokenImage(payload) ) {
+        payload.insert(0, symbols);
+        memcpy(header.magic, SNAPSHOT_MAGIC, 4);
+        header.version = SNAPSHOT_VERSION;
+        header.sourceHash = sourceHash;
+        header.sourceInput = sourceInput ? 1 : 0;
+        header.firstStatement = currToken + 1;
+        header.symbolCount = symTable.size();
+        header.symbolBytes = symbols.size();
+        header.checksum = checksum((const unsigned char *) payload.data(), payload.size());
+
+        //write next to the snapshot and rename over it, so a reader never sees half of one
+        string tempFile = snapshotFile + ".tmp";
+        ofstream snapshot (tempFile.c_str(), ios::binary | ios::trunc);
+        snapshot.write((const char *) &header, sizeof(header));
+        snapshot.write(payload.data(), payload.size());
+        snapshot.close();
+        if ( !snapshot.good() || rename(tempFile.c_str(), snapshotFile.c_str()) != 0 ) {
+            remove(tempFile.c_str());
+            *out << "Error: could not write snapshot " << snapshotFile << endl;
+        }
+    }
+    programStatements();
+    return true;
+}
+
+/*
+ *===================================================================
+ *  PROGRAM FCN -- consume tokens at start and end of a program, 
+ *                 call fcns to consume other tokens in declarations
+ *                 and statements
+ *===================================================================
+ */
+
+void program () {
+
+    programHeader();
+    if ( bindingRow != 0 ) {
+        applyBindings();
+    }
+    programStatements();
+}
+
+
+void programHeader () {
+    
+    //no if-statement or while-loop is running yet, and no operator site is specialized
+    execFrames.clear();
+    quickSites.clear();
+
+    //advance index to first element in token vector and begin by consuming a type
+    string programToken = tokens->at(++currToken);
+    if ( programToken != "type" ) {
+        *out << "Error: 'type' token missing for main function return value" << endl;
+        stop(0);
+    }
+    //consume 'main' token
+    programToken = tokens->at(++currToken);
+    if ( programToken != "main" ) {
+        *out << "Error: 'main' token missing" <<endl;
+        stop(0);
+    }
+    //consume '(' token
+    programToken = tokens->at(++currToken);
+    if ( programToken != "(" ) {
+        *out << "Error: '(' token missing in main function" <<endl;
+        stop(0);
+    }
+    //consume ')' token
+    programToken = tokens->at(++currToken);
+    if ( programToken != ")" ) {
+        *out << "Error: ')' token missing in main function" <<endl;
+        stop(0);
+    }
+    //consume '{' token
+    programToken = tokens->at(++currToken);
+    if ( programToken != "{" ) {
+        *out << "Error: '{' token missing at beginning of main function" <<endl;
+        stop(0);
+    }
+    
+    //parse for all declarations; statements are parsed by programStatements
+    declarations();
+    if ( memPhases.size() == 1 ) {
+        recordPhase("parse");
+    }
+}
+
+
+void programStatements () {
+
+    string programToken;
+    statements();
+    
+    //consume '}' token for end of main function
+    programToken = tokens->at(++currToken);
+    if ( programToken != "}" ) {
+        *out << "Error: '}' token missing at end of main function" <<endl;
+        stop(0);
+    }
+}
+
+/* 
+ *=======================================
+ *  FCNS FOR DECLARATIONS AND STATEMENTS
+ *=======================================
+ */ 
+
+
+void declarations () {
+    //parse all declarations first
+    while ( currToken < tokens->size() - 1 ) {
+        //if the next token is not 'type', it must not be the start of a new declaration
+        string typeToken = tokens->at(++currToken);
+        if ( typeToken != "type" ) {
+            currToken--;
+            return;
+        }
+        if ( collectErrors ) {
+            runRecovering(false);
+        }
+        else {
+            declaration();
+        }
+    }
+}
+
+
+void declaration () {
+    
+    //save the index of the last type so we can refer back to that type if there is a
+    //string of comma-separated declarations
     lastTypeIndex = currToken;
     
     //if last token was 'type', next token consumed must be 'id'
@@ -224,8 +1515,8 @@ void declaration () {
         addSymbol();
     }
     else {
-        cout << "Error: missing 'id' token at start of declaration" << endl;
-        exit(0);
+        *out << "Error: missing 'id' token at start of declaration" << endl;
+        stop(0);
     }
     //check for series of declarations separated by commas
     while ( currToken < tokens->size() - 1 ) {
@@ -236,8 +1527,8 @@ void declaration () {
         }
         decToken = tokens->at(++currToken);
         if ( decToken != "id" ) {
-            cout << "Error: missing 'id' token in series of declarations" << endl;
-            exit(0);
+            *out << "Error: missing 'id' token in series of declarations" << endl;
+            stop(0);
         }
         //if another variable is declared, must add it to symbol table
         addSymbol();
@@ -245,8 +1536,8 @@ void declaration () {
     //consume ';' at end of line of declaration(s)
     decToken = tokens->at(++currToken);
     if ( decToken != ";" ) {
-        cout << "Error: ';' token missing from end of declaration" << endl;
-        exit(0);
+        *out << "Error: ';' token missing from end of declaration" << endl;
+        stop(0);
     }
 }
 
@@ -267,7 +1558,12 @@ void statements () {
             currToken--;
             //argument is true because we will allow a variable's value to be updated in the
             //symbol table while declarations and statements are being made
-            statement(true);
+            if ( collectErrors ) {
+                runRecovering(true);
+            }
+            else {
+                statement(true);
+            }
         }
     }
 }
@@ -276,6 +1572,7 @@ void statements () {
 void statement (bool assign) {
     
     int statementToken = currToken;
+    stepCount++;
     //check for each kind of statement   
     assignment(true);
     //don't check multiple types of statements
@@ -313,32 +1610,66 @@ void assignment (bool assign) {
     }
     
     //save id
+    int idToken = currToken;
     string id = lexemes->at(currToken);
 
+    //an assignment to an array element writes straight into the array's storage
+    Multivalue *element = 0;
+    string elementType;
+    int index = 0;
+    if ( currToken + 1 < (int) tokens->size() && tokens->at(currToken + 1) == "[" ) {
+        element = &arrayElement(elementType, index);
+    }
+
     //consume 'assignOp' token
     assignToken = tokens->at(++currToken);
     if ( assignToken != "assignOp" ) {
-        cout << "Error: 'assignOp' token missing from assignment" << endl;
-        exit(0);
+        *out << "Error: 'assignOp' token missing from assignment" << endl;
+        stop(0);
     }
     
     //get the expression following the assignment
     Heterogeneous assignVal = expression();
     
+    //elements follow the same type rules as scalars
+    bool stored = true;
+    if ( element != 0 ) {
+        if ( elementType == assignVal.type && assign ) {
+            *element = assignVal.value;
+        }
+        else if ( elementType == "float" && assignVal.type == "int" && assign ) {
+            element->fValue = assignVal.value.iValue;
+        }
+        else {
+            stored = false;
+        }
+    }
     //check if variable is of same type as its assignment (and that 'assign' is true)
-    if ( symTable[id].type == assignVal.type && assign ) {
+    else if ( symTable[id].type == assignVal.type && assign ) {
         symTable[id] = assignVal;
     }
     //widening conversion for floats (Type Rule 3)
     else if ( symTable[id].type == "float" && assignVal.type == "int" && assign ) {
         symTable[id].value.fValue = assignVal.value.iValue;
     }
+    else {
+        stored = false;
+    }
+    if ( tracing && stored ) {
+        if ( element != 0 ) {
+            traceStore(TRACE_ELEMENT, idToken, index, elementType, *element);
+        }
+        else {
+            Heterogeneous &entry = symTable[id];
+            traceStore(TRACE_ASSIGN, idToken, 0, entry.type, entry.value);
+        }
+    }
 
     //consume ';' token at end of assignment
     assignToken = tokens->at(++currToken);
     if ( assignToken != ";" ) {
-        cout << "Error: ';' token missing from end of assignment" << endl;
-        exit(0);
+        *out << "Error: ';' token missing from end of assignment" << endl;
+        stop(0);
     }
 }
 
@@ -352,7 +1683,7 @@ Heterogeneous expression () {
     //      --> only can mix floats and ints (not bools and chars)
     
     //parse the conjunction, save the result for semantic analysis
-    Heterogeneous result = conjunction();
+    Heterogeneous result = ::conjunction();
     Heterogeneous temp;
     
     //as long as next token is '||', parse all ensuing conjunctions
@@ -364,17 +1695,17 @@ Heterogeneous expression () {
             //check to make sure result has type bool; only bools
             //can use logical operators
             if ( result.type != "bool" ) {
-                cout << "Error: cannot use logical operator '||' on non-boolean types" << endl;
-                exit(0); 
+                *out << "Error: cannot use logical operator '||' on non-boolean types" << endl;
+                stop(0); 
             }
 
             //get next conjunction production
-            temp = conjunction();
+            temp = ::conjunction();
 
             //make sure temp has type 'bool'
             if ( temp.type != "bool" ) {
-                cout << "Error: cannot use logical operator '||' on non-boolean types" << endl;
-                exit(0); 
+                *out << "Error: cannot use logical operator '||' on non-boolean types" << endl;
+                stop(0); 
             }
 
             //update the value of the result
@@ -409,8 +1740,8 @@ Heterogeneous conjunction () {
             //check to make sure result has type bool; if not, error 
             //(cannot use logical operators on non-boolean types)
             if ( result.type != "bool" ) {
-                cout << "Error: cannot use logical operator '&&' on non-boolean types" << endl;
-                exit(0); 
+                *out << "Error: cannot use logical operator '&&' on non-boolean types" << endl;
+                stop(0); 
             }
 
             //get next equality production
@@ -418,8 +1749,8 @@ Heterogeneous conjunction () {
 
             //check if temp has type 'bool'
             if ( temp.type != "bool" ) {
-                cout << "Error: cannot use logical operator '&&' on non-boolean types" << endl;
-                exit(0); 
+                *out << "Error: cannot use logical operator '&&' on non-boolean types" << endl;
+                stop(0); 
             }
 
             //update the value of the result
@@ -446,29 +1777,34 @@ Heterogeneous conjunction () {
 Heterogeneous equality () {
     
     //parse the relation, save the result for semantic analysis
-    Heterogeneous result = relation();
+    Heterogeneous result = ::relation();
     Heterogeneous temp;
 
     //keep track of which equality symbol
     bool equal = false;
 
-    //if next token is 'equOp', parse another relation
-    string equToken = tokens->at(++currToken);
-    if ( equToken == "equOp" ) {
-     
+    //if next token is 'equOp', parse another relation (a quickened site is known to be one)
+    int site = ++currToken;
+    if ( quickened(site, QUICK_FLOAT_EQ_FLOAT, QUICK_INT_NE_INT) || tokens->at(site) == "equOp" ) {
+
+        //get next relation production
+        temp = ::relation();
+
+        //a quickened site runs its specialized form while the operand kinds still match
+        if ( runQuickened(site, result, temp) ) {
+            return result;
+        }
+
         //find which equality symbol
-        if ( lexemes->at(currToken) == "==" ) {
+        if ( lexemes->at(site) == "==" ) {
             equal = true;
         }
 
-        //get next relation production
-        temp = relation();
-
         //cannot do comparison of chars or bools in this program
         if ( temp.type == "charLiteral" || temp.type == "boolLiteral" || result.type
             == "charLiteral" || result.type == "boolLiteral" ) {
-            cout << "Error: cannot perform comparison on chars or bools" << endl;
-            exit(0);
+            *out << "Error: cannot perform comparison on chars or bools" << endl;
+            stop(0);
         }
 
         //keep track of whether either temp or result has type 'float'
@@ -481,6 +1817,13 @@ Heterogeneous equality () {
             resultFloat = true;
         }
 
+        //specialize the site for these operand kinds (float/float, float/int, int/float,
+        //int/int, in the order of the forms)
+        unsigned char left = operandKind(result.type);
+        unsigned char right = operandKind(temp.type);
+        int pair = ( resultFloat ? 0 : 2 ) + ( tempFloat ? 0 : 1 );
+        quicken(site, left, right, QUICK_FLOAT_EQ_FLOAT + pair * 2 + ( equal ? 0 : 1 ));
+
         //update result type to boolean 
         result.type = "bool";
 
@@ -533,33 +1876,38 @@ Heterogeneous relation () {
     bool gre = false;
     bool greq = false;
 
-    //if next token is 'relOp', parse for addition again
-    string relToken = tokens->at(++currToken);
-    if ( relToken == "relOp" ) {
-        string relLex = lexemes->at(currToken);
-    
+    //if next token is 'relOp', parse for addition again (a quickened site is known to be one)
+    int site = ++currToken;
+    if ( quickened(site, QUICK_FLOAT_LT_FLOAT, QUICK_INT_GT_INT) || tokens->at(site) == "relOp" ) {
+
+        //get next addition production
+        temp = addition();
+
+        //a quickened site runs its specialized form while the operand kinds still match
+        if ( runQuickened(site, result, temp) ) {
+            return result;
+        }
+
         //find which relative operator
-        if ( lexemes->at(currToken) == "<" ) {
+        string &relLex = lexemes->at(site);
+        if ( relLex == "<" ) {
             less = true;
         }
-        else if ( lexemes->at(currToken) == "<=" ) {
+        else if ( relLex == "<=" ) {
             leq = true;
         }
-        else if ( lexemes->at(currToken) == ">" ) {
+        else if ( relLex == ">" ) {
             gre = true;
         }
         else {
             greq = true;
         }
 
-        //get next addition production
-        temp = addition();
-
         //cannot do relative comparison of chars or bools in this program
         if ( temp.type == "charLiteral" || temp.type == "boolLiteral" || result.type
             == "charLiteral" || result.type == "boolLiteral" ) {
-            cout << "Error: cannot perform relative comparison on chars or bools" << endl;
-            exit(0);
+            *out << "Error: cannot perform relative comparison on chars or bools" << endl;
+            stop(0);
         }
 
         //keep track of whether either temp or result has type 'float'
@@ -572,6 +1920,14 @@ Heterogeneous relation () {
             resultFloat = true;
         }
 
+        //specialize the site for these operand kinds (float/float, float/int, int/float,
+        //int/int, in the order of the forms)
+        unsigned char left = operandKind(result.type);
+        unsigned char right = operandKind(temp.type);
+        int pair = ( resultFloat ? 0 : 2 ) + ( tempFloat ? 0 : 1 );
+        int op = less ? 0 : leq ? 1 : gre ? 2 : 3;
+        quicken(site, left, right, QUICK_FLOAT_LT_FLOAT + pair * 4 + op);
+
         //update result type to boolean 
         result.type = "bool";
 
@@ -641,31 +1997,40 @@ Heterogeneous addition () {
     //keep track of which addOp operand
     bool plus = false;
 
-    //as long as next token is 'addOp', parse another term
-    string addToken;
+    //as long as next token is 'addOp', parse another term (a quickened site is known to be one)
     while ( currToken < tokens->size() - 1 ) {
-        addToken = tokens->at(++currToken);
-        if ( addToken == "addOp" ) {
-            
-            //find out which operation to perform
-            if ( lexemes->at(currToken) == "+" ) {
-                plus = true;
-            }
+        int site = ++currToken;
+        if ( quickened(site, QUICK_INT_ADD_INT, QUICK_FLOAT_SUB_INT) || tokens->at(site) == "addOp" ) {
 
             //find next term production
             temp = term();
 
+            //a quickened site runs its specialized form while the operand kinds still match
+            if ( runQuickened(site, result, temp) ) {
+                continue;
+            }
+
+            //find out which operation to perform
+            if ( lexemes->at(site) == "+" ) {
+                plus = true;
+            }
+
             //cannot add or subract chars or bools
             if ( temp.type == "charLiteral" || temp.type == "boolLiteral" || result.type
                 == "charLiteral" || result.type == "boolLiteral" ) {
-                cout << "Error: cannot perform +|- on chars or bools" << endl;
-                exit(0);
+                *out << "Error: cannot perform +|- on chars or bools" << endl;
+                stop(0);
             }
 
             //keep track of whether either temp or result has type 'float'
             bool tempFloat = false;
             bool resultFloat = false;
 
+            //operand kinds and the specialized form the site is given below
+            unsigned char left = operandKind(result.type);
+            unsigned char right = operandKind(temp.type);
+            int form = QUICK_NONE;
+
             //if one factor is a 'float', the type of the result must be 'float'; otherwise type is 'int'
             if ( temp.type == "floatLiteral" || result.type == "floatLiteral" ) {
                 result.type = "float";
@@ -679,6 +2044,7 @@ Heterogeneous addition () {
 
                 //update value in case where temp is 'int', result is 'float'
                 if ( !tempFloat ) {
+                    form = plus ? QUICK_FLOAT_ADD_INT : QUICK_FLOAT_SUB_INT;
                     if ( plus ){
                         result.value.fValue = result.value.fValue + temp.value.iValue;
                     }
@@ -688,6 +2054,7 @@ Heterogeneous addition () {
                 }
                 //update value in case where temp is 'float', result is 'int'
                 else if ( !resultFloat ) {
+                    form = plus ? QUICK_INT_ADD_FLOAT : QUICK_INT_SUB_FLOAT;
                     if ( plus ){
                         result.value.fValue = result.value.iValue + temp.value.fValue;
                     }
@@ -707,6 +2074,7 @@ Heterogeneous addition () {
             }
             //type of result is 'int', update value (both temp and result have type 'int')
             else {
+                form = plus ? QUICK_INT_ADD_INT : QUICK_INT_SUB_INT;
                 if ( plus ){
                         result.value.iValue = result.value.iValue + temp.value.iValue;
                 }
@@ -714,6 +2082,9 @@ Heterogeneous addition () {
                         result.value.iValue = result.value.iValue - temp.value.iValue;
                 }
             }
+            if ( form != QUICK_NONE ) {
+                quicken(site, left, right, form);
+            }
             plus = false;
         }
         else {
@@ -759,8 +2130,8 @@ Heterogeneous term () {
             //cannot multiply or divide chars or bools
             if ( temp.type == "charLiteral" || temp.type == "boolLiteral" || result.type
                 == "charLiteral" || result.type == "boolLiteral" ) {
-                cout << "Error: cannot perform *|/ on chars or bools" << endl;
-                exit(0);
+                *out << "Error: cannot perform *|/ on chars or bools" << endl;
+                stop(0);
             }
 
             //keep track of whether either temp or result has type 'float'
@@ -817,6 +2188,18 @@ Heterogeneous term () {
             }
             //else the result is an int, calculate new value
             else {
+                //a server worker would not survive the hardware trap (raised by a zero
+                //divisor and by INT_MIN / -1), so report it instead (a parallel region stays
+                //quiet; the trap is raised again once the output before it has been printed)
+                bool zero = temp.value.iValue == 0;
+                if ( containedRun && ( divide || mod ) &&
+                    ( zero || ( temp.value.iValue == -1 && result.value.iValue == INT_MIN ) ) ) {
+                    if ( parallelRegion < 0 && !cachedRun ) {
+                        *out << "Error: " << ( zero ? "integer division by zero" : "integer overflow in division" )
+                             << endl;
+                    }
+                    stop(128 + SIGFPE);
+                }
                 if ( mult ) {
                     result.value.iValue = result.value.iValue * temp.value.iValue;
                 }
@@ -856,12 +2239,28 @@ Heterogeneous factor () {
         
         //if factor is an id, that heterogeneous object already exists in the symbol table
         if ( type == "id") {
-            if ( symTable.count(lexemes->at(currToken)) == 0 ) {
-                cout << "Error: use of undeclared identifier" << endl;
-                exit(0);
+            //an id followed by '[' is an array element
+            if ( currToken + 1 < (int) tokens->size() && tokens->at(currToken + 1) == "[" ) {
+                int index;
+                result.value = arrayElement(result.type, index);
+            }
+            else {
+                if ( symTable.count(lexemes->at(currToken)) == 0 ) {
+                    *out << "Error: use of undeclared identifier" << endl;
+                    stop(0);
+                }
+                result = symTable[lexemes->at(currToken)];
+                if ( !result.type.empty() && result.type[result.type.size() - 1] == ']' ) {
+                    *out << "Error: array " << lexemes->at(currToken) << " used without an index" << endl;
+                    stop(0);
+                }
             }
-            result = symTable[lexemes->at(currToken)];
-            
+        }
+        //use the value decoded when the program was loaded, if there is one
+        else if ( tokenLiterals != 0 && currToken < (int) tokenLiterals->size() &&
+            (*tokenLiterals)[currToken].decoded ) {
+            result.value = (*tokenLiterals)[currToken].value;
+            result.type = type == "intLiteral" ? "int" : "float";
         }
         else if ( type == "intLiteral" ) {
             value.iValue = stoi(lexemes->at(currToken));
@@ -897,15 +2296,15 @@ Heterogeneous factor () {
 
         //consume ')' at end of expression factor
         if ( factor != ")" ) {
-            cout << "Error: missing ')' token in Factor -> (Expression)" << endl;
-            exit(0);
+            *out << "Error: missing ')' token in Factor -> (Expression)" << endl;
+            stop(0);
         }
     }
     
     //if next token is not a factor, print error message and exit
     else {
-        cout << "Error: missing factor" << endl;
-        exit(0);
+        *out << "Error: missing factor" << endl;
+        stop(0);
     }
     return result;
 }
@@ -931,8 +2330,8 @@ void returnStmt () {
     //consume ';' token at end of return statement
     retToken = tokens->at(++currToken);
     if ( retToken != ";" ) {
-        cout << "Error: ';' token missing at end of returnStmt" << endl;
-        exit(0);
+        *out << "Error: ';' token missing at end of returnStmt" << endl;
+        stop(0);
     }
 }
 
@@ -945,42 +2344,67 @@ void ifStmt () {
         return;
     }
 
-    //consume '(' token at start of if statement
-    ifToken = tokens->at(++currToken);
-    if ( ifToken == "(" ) {
+    int keyword = currToken;
+    Heterogeneous ifVal;
+    bool inElse = false;
+
+    //when resuming from a checkpoint, go straight back into the branch that was running
+    ExecFrame *resumed = resumeFrame(keyword);
+    if ( resumed != 0 ) {
+        ifVal.value.bValue = resumed->cond;
+        inElse = resumed->inElse;
+        currToken = resumed->body;
+    }
+    else {
+        //consume '(' token at start of if statement
+        ifToken = tokens->at(++currToken);
+        if ( ifToken != "(" ) {
+            *out << "Error: '(' token missing in ifStmt" << endl;
+            stop(0);
+        }
+
         //get expression
-        Heterogeneous ifVal = expression();
+        ifVal = expression();
 
         //check to make sure if statement condition is boolean expression
         if ( ifVal.type != "bool" ) {
-            cout << "Error: must have boolean expression in if-statement condition" << endl;
-            exit(0);
+            *out << "Error: must have boolean expression in if-statement condition" << endl;
+            stop(0);
         }
 
         //consume ')' at end of if statement
         ifToken = tokens->at(++currToken);
-        if ( ifToken == ")" ) {
+        if ( ifToken != ")" ) {
+            *out << "Error: ')' token missing in ifStmt" << endl;
+            stop(0);
+        }
+        if ( tracing ) {
+            traceBranch(TRACE_IF, keyword, ifVal.value.bValue);
+        }
+    }
 
-            statement( ifVal.value.bValue );
+    //remember which branch is running in case a checkpoint is written inside it
+    ExecFrame frame = { keyword, 0, 0, currToken, ifVal.value.bValue, inElse };
+    execFrames.push_back(frame);
 
-            //check for else statement
-            ifToken = tokens->at(++currToken);
-            if ( ifToken == "else" ) {
-                statement( !ifVal.value.bValue );
-            }
-            else {
-                currToken--;
-            }
+    if ( !inElse ) {
+        statement( ifVal.value.bValue );
+
+        //check for else statement
+        ifToken = tokens->at(++currToken);
+        if ( ifToken == "else" ) {
+            execFrames.back().inElse = true;
+            execFrames.back().body = currToken;
+            statement( !ifVal.value.bValue );
         }
         else {
-            cout << "Error: ')' token missing in ifStmt" << endl;
-            exit(0);
+            currToken--;
         }
     }
     else {
-            cout << "Error: '(' token missing in ifStmt" << endl;
-            exit(0);
+        statement( !ifVal.value.bValue );
     }
+    execFrames.pop_back();
 }
 
 void printStmt () {
@@ -998,24 +2422,24 @@ void printStmt () {
         Heterogeneous printVal = expression();
 
         if ( printVal.type == "int" ) {
-            cout << printVal.value.iValue << endl;
+            *out << printVal.value.iValue << endl;
         }
         else if ( printVal.type == "float" ) {
-            cout << printVal.value.fValue << endl;
+            *out << printVal.value.fValue << endl;
         }
         else if ( printVal.type == "bool" ) {
-            cout << printVal.value.bValue << endl;
+            *out << printVal.value.bValue << endl;
         }
         else {
-            cout << printVal.value.cValue << endl;
+            *out << printVal.value.cValue << endl;
         }
     }
 
     //consume ';' token at end of print statement
     pToken = tokens->at(++currToken);
     if ( pToken != ";" ) {
-        cout << "Error: missing ';' at end of printStmt" << endl;
-        exit(0);
+        *out << "Error: missing ';' at end of printStmt" << endl;
+        stop(0);
     }
 }
 
@@ -1027,19 +2451,64 @@ void whileStmt () {
         currToken--;
         return;
     }
+    int keyword = currToken;
     
     Heterogeneous whileVal;
 
-    //consume '(' token at beginning of while statement
-    wToken = tokens ->at(++currToken);
-    if ( wToken == "(" ) {
-        //keep track of starting while token, will reset this every time while loop runs
-        //--> this is because we want to parse the same expression until it is no longer
-        //    true
-        int startWhileToken = currToken;
-        int endWhileToken = 0;
+    //keep track of starting while token, will reset this every time while loop runs
+    //--> this is because we want to parse the same expression until it is no longer
+    //    true
+    int startWhileToken;
+    int endWhileToken = 0;
+    bool resumeInBody = false;
+
+    //when resuming from a checkpoint, pick the loop up where it was: either at its back-edge
+    //(the innermost loop) or inside its body (every loop enclosing that one)
+    ExecFrame *resumed = resumeFrame(keyword);
+    if ( resumed != 0 ) {
+        startWhileToken = resumed->start;
+        endWhileToken = resumed->end;
+        whileVal.type = "bool";
+        whileVal.value.bValue = resumed->cond;
+        if ( resumeDepth == (int) resumeFrames.size() ) {
+            resumeFrames.clear();
+            resumeDepth = 0;
+            if ( !whileVal.value.bValue ) {
+                currToken = endWhileToken;
+                return;
+            }
+        }
+        else {
+            resumeInBody = true;
+        }
+    }
+    //an element-wise loop over int arrays runs as a whole in one kernel call
+    else if ( runElementLoop(keyword) ) {
+        return;
+    }
+    else {
+        //consume '(' token at beginning of while statement
+        wToken = tokens ->at(++currToken);
+        if ( wToken != "(" ) {
+            *out << "Error: missing '(' token in whileStmt" << endl;
+            stop(0);
+        }
+        startWhileToken = currToken;
+    }
+
+    ExecFrame frame = { keyword, startWhileToken, endWhileToken, 0, false, false };
+    if ( resumeInBody ) {
+        frame = *resumed;
+    }
+    execFrames.push_back(frame);
+    int depth = execFrames.size() - 1;
          
-        do {
+    do {
+        if ( resumeInBody ) {
+            currToken = execFrames[depth].body;
+            resumeInBody = false;
+        }
+        else {
             currToken = startWhileToken;
 
             //parse an expression
@@ -1047,36 +2516,46 @@ void whileStmt () {
 
             //while statement condition expression must have type 'bool'
             if ( whileVal.type != "bool" ) {
-                cout << "Error: must have boolean expression as while-statement condition" << endl;
-                exit(0);
+                *out << "Error: must have boolean expression as while-statement condition" << endl;
+                stop(0);
             }
 
             //consume ')' token at end of expression
             wToken = tokens ->at(++currToken);
-            if ( wToken == ")" ) { 
-
-                //if condition is no longer true, don't parse the statement
-                if ( !whileVal.value.bValue && endWhileToken != 0 ) {
-                    currToken = endWhileToken;
-                    break;
-                }
-                //parse a statement
-                statement(whileVal.value.bValue);
+            if ( wToken != ")" ) {
+                *out << "Error: missing ')' token in whileStmt" << endl;
+                stop(0);
             }
-            else {
-                cout << "Error: missing ')' token in whileStmt" << endl;
-                exit(0);
+            if ( tracing ) {
+                traceBranch(TRACE_WHILE, keyword, whileVal.value.bValue);
             }
 
-            endWhileToken = currToken;
+            //if condition is no longer true, don't parse the statement
+            if ( !whileVal.value.bValue && endWhileToken != 0 ) {
+                currToken = endWhileToken;
+                break;
+            }
+            execFrames[depth].body = currToken;
+            execFrames[depth].cond = whileVal.value.bValue;
+        }
 
-        } while (whileVal.value.bValue);
+        //parse a statement
+        statement(whileVal.value.bValue);
 
-    }
-    else {
-        cout << "Error: missing '(' token in whileStmt" << endl;
-        exit(0);
-    }
+        endWhileToken = currToken;
+        execFrames[depth].end = endWhileToken;
+
+        //count the back-edge; the clock is only read every 1024 iterations
+        if ( ++loopIterations + stepCount > maxSteps || ( maxMillis > 0 &&
+            ( loopIterations & 1023 ) == 0 ) ) {
+            checkBudgets();
+        }
+        if ( loopIterations >= nextSuspend ) {
+            suspendRun();
+        }
+
+    } while (whileVal.value.bValue);
+    execFrames.pop_back();
 }
 
 /*
@@ -1092,8 +2571,8 @@ void addSymbol () {
     
     //make sure no two variables have the same name
     if ( symTable.count(varName) != 0 ) {
-        cout << "Error: " << varName << " is already being used as an identifier" << endl;
-        exit(0);
+        *out << "Error: " << varName << " is already being used as an identifier" << endl;
+        stop(0);
     }
     
     //value has not yet been assigned
@@ -1101,7 +2580,3354 @@ void addSymbol () {
     
     //make a new entry with the type and value
     Heterogeneous entry (varType, mv);
+
+    //an array declaration gives its length in brackets after the id, e.g. 'int a[1024]'
+    if ( currToken + 1 < (int) tokens->size() && tokens->at(currToken + 1) == "[" ) {
+        currToken += 2;
+        long long length = 0;
+        if ( tokens->at(currToken) == "intLiteral" ) {
+            length = strtoll(lexemes->at(currToken).c_str(), 0, 10);
+        }
+        if ( length <= 0 || tokens->at(++currToken) != "]" ) {
+            *out << "Error: array " << varName << " needs a positive int literal length" << endl;
+            stop(0);
+        }
+        if ( length > MAX_ARRAY_LENGTH ) {
+            *out << "Error: array " << varName << " is longer than the limit of "
+                 << MAX_ARRAY_LENGTH << " elements" << endl;
+            stop(0);
+        }
+        entry.type = varType + "[]";
+        entry.value.iValue = length;
+        allocateArray(varName, entry);
+    }
     
     //add new entry in the symbol table using variable name as key
     symTable[varName] = entry;
 }
+
+
+void allocateArray (const string &name, const Heterogeneous &entry) {
+
+    //elements start out zeroed, unlike scalars
+    ArrayStorage &array = arrayTable[name];
+    array.type = entry.type.substr(0, entry.type.size() - 2);
+    Multivalue zero;
+    zero.iValue = 0;
+    array.elements.assign(entry.value.iValue, zero);
+}
+
+
+Multivalue &arrayElement (string &type, int &index) {
+
+    //currToken is the array's id; consume '[' index ']' and return the element it names
+    string id = lexemes->at(currToken);
+    map<string, ArrayStorage>::iterator array = arrayTable.find(id);
+    if ( array == arrayTable.end() ) {
+        if ( symTable.count(id) == 0 ) {
+            *out << "Error: use of undeclared identifier" << endl;
+        }
+        else {
+            *out << "Error: " << id << " is not an array" << endl;
+        }
+        stop(0);
+    }
+    currToken++;
+    Heterogeneous position = expression();
+    if ( position.type != "int" ) {
+        *out << "Error: array index must be an int" << endl;
+        stop(0);
+    }
+    if ( tokens->at(++currToken) != "]" ) {
+        *out << "Error: ']' token missing after array index" << endl;
+        stop(0);
+    }
+    vector<Multivalue> &elements = array->second.elements;
+    index = position.value.iValue;
+    if ( index < 0 || index >= (int) elements.size() ) {
+        *out << "Error: index " << index << " out of bounds for array " << id
+             << " of length " << elements.size() << endl;
+        stop(0);
+    }
+    type = array->second.type;
+    return elements[index];
+}
+
+
+bool elementSum (int &pos, const string &index, vector<ElementOp> &program, vector<size_t> &lengths,
+    int depth) {
+
+    //sum := product (addOp product)*, product := operand ('*' operand)*, as in addition()
+    //and term(); pos is left on the last token used
+    if ( depth > ELEMENT_DEPTH ) {
+        return false;
+    }
+    bool first = true;
+    ElementOpKind pending = ELEMENT_ADD;
+    while ( true ) {
+        if ( !elementOperand(pos, index, program, lengths, depth) ) {
+            return false;
+        }
+        while ( pos + 1 < (int) tokens->size() && tokens->at(pos + 1) == "multOp" ) {
+            if ( lexemes->at(pos + 1) != "*" ) {
+                return false;
+            }
+            pos++;
+            if ( !elementOperand(pos, index, program, lengths, depth) ) {
+                return false;
+            }
+            ElementOp op = { ELEMENT_MUL, 0, 0 };
+            program.push_back(op);
+        }
+        if ( !first ) {
+            ElementOp op = { pending, 0, 0 };
+            program.push_back(op);
+        }
+        first = false;
+        if ( pos + 1 >= (int) tokens->size() || tokens->at(pos + 1) != "addOp" ) {
+            return true;
+        }
+        pending = lexemes->at(++pos) == "+" ? ELEMENT_ADD : ELEMENT_SUB;
+    }
+}
+
+bool elementOperand (int &pos, const string &index, vector<ElementOp> &program, vector<size_t> &lengths,
+    int depth) {
+
+    //an int literal, an int scalar (the index itself reads as the element's position),
+    //an int array read at [index], or a parenthesized sum
+    if ( ++pos >= (int) tokens->size() - 3 ) {
+        return false;
+    }
+    const string &kind = tokens->at(pos);
+    ElementOp op = { ELEMENT_CONST, 0, 0 };
+    if ( kind == "intLiteral" ) {
+        Multivalue value;
+        if ( tokenLiterals != 0 && pos < (int) tokenLiterals->size() && (*tokenLiterals)[pos].decoded )
+            value = (*tokenLiterals)[pos].value;
+        else if ( !decodeLiteral(kind, lexemes->at(pos), value) )
+            return false;
+        op.value = value.iValue;
+    }
+    else if ( kind == "(" ) {
+        if ( !elementSum(pos, index, program, lengths, depth + 1) || pos + 1 >= (int) tokens->size() ||
+            tokens->at(++pos) != ")" ) {
+            return false;
+        }
+        return true;
+    }
+    else if ( kind == "id" && tokens->at(pos + 1) == "[" ) {
+        map<string, ArrayStorage>::iterator array = arrayTable.find(lexemes->at(pos));
+        if ( array == arrayTable.end() || array->second.type != "int" || tokens->at(pos + 2) != "id" ||
+            lexemes->at(pos + 2) != index || tokens->at(pos + 3) != "]" ) {
+            return false;
+        }
+        op.kind = ELEMENT_ARRAY;
+        op.elements = array->second.elements.data();
+        lengths.push_back(array->second.elements.size());
+        pos += 3;
+    }
+    else if ( kind == "id" ) {
+        map<string, Heterogeneous>::iterator scalar = symTable.find(lexemes->at(pos));
+        if ( scalar == symTable.end() || scalar->second.type != "int" ) {
+            return false;
+        }
+        op.kind = lexemes->at(pos) == index ? ELEMENT_INDEX : ELEMENT_CONST;
+        op.value = scalar->second.value.iValue;
+    }
+    else {
+        return false;
+    }
+    program.push_back(op);
+    return true;
+}
+
+
+void elementBlock (ElementOpKind kind, uint32_t *__restrict left, const uint32_t *__restrict right) {
+
+    //one operator over a block; the rows never overlap, and saying so (restrict is only
+    //trusted on parameters) lets the loops be vectorized without alias checks
+    if ( kind == ELEMENT_ADD )
+        for ( int j = 0; j < ELEMENT_BLOCK; j++ ) left[j] += right[j];
+    else if ( kind == ELEMENT_SUB )
+        for ( int j = 0; j < ELEMENT_BLOCK; j++ ) left[j] -= right[j];
+    else
+        for ( int j = 0; j < ELEMENT_BLOCK; j++ ) left[j] *= right[j];
+}
+
+
+void elementFill (uint32_t *__restrict values, uint32_t first, uint32_t step) {
+
+    //a constant (step 0) or the index of each element in a block
+    for ( int j = 0; j < ELEMENT_BLOCK; j++ ) {
+        values[j] = first + j * step;
+    }
+}
+
+
+bool runElementLoop (int keyword) {
+
+    //the kernel skips the per-iteration work that tracing, time budgets and suspensions
+    //(checkpoints, parallel polls, scheduler slices) observe, so those runs never use it
+    if ( tracing || maxMillis > 0 ) {
+        return false;
+    }
+    const vector<string> &t = *tokens;
+    const vector<string> &l = *lexemes;
+    int size = t.size();
+    int pos = keyword;
+    if ( pos + 16 >= size || t[pos + 1] != "(" || t[pos + 2] != "id" || t[pos + 3] != "relOp" ||
+        ( l[pos + 3] != "<" && l[pos + 3] != "<=" ) || t[pos + 5] != ")" || t[pos + 6] != "if" ||
+        t[pos + 7] != "(" || t[pos + 8] != "boolLiteral" || l[pos + 8] != "true" || t[pos + 9] != ")" ||
+        t[pos + 10] != "id" || t[pos + 11] != "[" || t[pos + 12] != "id" || l[pos + 12] != l[pos + 2] ||
+        t[pos + 13] != "]" || t[pos + 14] != "assignOp" ) {
+        return false;
+    }
+    const string &index = l[pos + 2];
+    map<string, Heterogeneous>::iterator counter = symTable.find(index);
+    map<string, ArrayStorage>::iterator target = arrayTable.find(l[pos + 10]);
+    if ( counter == symTable.end() || counter->second.type != "int" || target == arrayTable.end() ||
+        target->second.type != "int" ) {
+        return false;
+    }
+
+    //the bound, then the right-hand side, then "; else i = i + k ;"
+    long long bound;
+    if ( t[pos + 4] == "id" ) {
+        map<string, Heterogeneous>::iterator limit = symTable.find(l[pos + 4]);
+        if ( limit == symTable.end() || limit->second.type != "int" ) {
+            return false;
+        }
+        bound = limit->second.value.iValue;
+    }
+    else {
+        Multivalue value;
+        if ( t[pos + 4] != "intLiteral" || !decodeLiteral(t[pos + 4], l[pos + 4], value) ) {
+            return false;
+        }
+        bound = value.iValue;
+    }
+    vector<ElementOp> program;
+    vector<size_t> lengths (1, target->second.elements.size());
+    pos += 14;
+    if ( !elementSum(pos, index, program, lengths, 0) || pos + 9 >= size ) {
+        return false;
+    }
+    Multivalue step;
+    if ( t[pos + 1] != ";" || t[pos + 2] != "else" || t[pos + 3] != "id" || l[pos + 3] != index ||
+        t[pos + 4] != "assignOp" || t[pos + 5] != "id" || l[pos + 5] != index || t[pos + 6] != "addOp" ||
+        l[pos + 6] != "+" || t[pos + 7] != "intLiteral" || t[pos + 8] != ";" ||
+        !decodeLiteral(t[pos + 7], l[pos + 7], step) || step.iValue <= 0 ) {
+        return false;
+    }
+
+    //count the iterations; a loop whose condition starts out false (its body still runs
+    //once), that would index out of bounds, or that would reach a budget or a suspension
+    //is left to the grammar functions, which report those exactly
+    long long first = counter->second.value.iValue;
+    if ( l[keyword + 3] == "<=" ) {
+        bound++;
+    }
+    if ( first >= bound || first < 0 ) {
+        return false;
+    }
+    long long count = ( bound - first + step.iValue - 1 ) / step.iValue;
+    long long last = first + ( count - 1 ) * step.iValue;
+    for ( int i = 0; i < (int) lengths.size(); i++ ) {
+        if ( last >= (long long) lengths[i] ) {
+            return false;
+        }
+    }
+    if ( maxSteps - stepCount - loopIterations < 4 * count || nextSuspend - loopIterations <= count ) {
+        return false;
+    }
+    int depth = 0;
+    for ( int o = 0; o < (int) program.size(); o++ ) {
+        depth += program[o].kind >= ELEMENT_ADD ? -1 : 1;
+        if ( depth > ELEMENT_DEPTH ) {
+            return false;
+        }
+    }
+
+    //run the postfix program over blocks of elements; unsigned arithmetic wraps the way
+    //the int operators do.  Every block is computed at full length (the tail of the last
+    //one is never stored), so -O2 can vectorize each operator's loop
+    static_assert(sizeof(Multivalue) == sizeof(uint32_t), "elements are copied as uint32_t");
+    uint32_t stack[ELEMENT_DEPTH][ELEMENT_BLOCK] = {};
+    Multivalue *stored = target->second.elements.data();
+    int stride = step.iValue;
+    for ( long long start = 0; start < count; start += ELEMENT_BLOCK ) {
+        int n = (int) min((long long) ELEMENT_BLOCK, count - start);
+        long long base = first + start * stride;
+        int top = -1;
+        for ( int o = 0; o < (int) program.size(); o++ ) {
+            const ElementOp &op = program[o];
+            if ( op.kind >= ELEMENT_ADD ) {
+                top--;
+                elementBlock(op.kind, stack[top], stack[top + 1]);
+                continue;
+            }
+            uint32_t *values = stack[++top];
+            if ( op.kind == ELEMENT_CONST ) {
+                elementFill(values, op.value, 0);
+            }
+            else if ( op.kind == ELEMENT_INDEX ) {
+                elementFill(values, (uint32_t) base, stride);
+            }
+            else if ( stride == 1 ) {
+                memcpy(values, op.elements + base, n * sizeof(uint32_t));
+            }
+            else {
+                for ( int j = 0; j < n; j++ ) values[j] = (uint32_t) op.elements[base + (long long) j * stride].iValue;
+            }
+        }
+        if ( stride == 1 ) {
+            memcpy(stored + base, stack[0], n * sizeof(uint32_t));
+        }
+        else {
+            for ( int j = 0; j < n; j++ ) {
+                stored[base + (long long) j * stride].iValue = (int) stack[0][j];
+            }
+        }
+    }
+
+    //leave everything as the grammar functions would: the index past the bound, three
+    //statements (if, its assignment, the else assignment) and one back-edge per element
+    counter->second.value.iValue = (int) ( first + count * stride );
+    stepCount += 3 * count;
+    loopIterations += count;
+    currToken = pos + 8;
+    return true;
+}
+
+
+void applyBindings () {
+
+    //give each bound variable its initial value for this instance, converting the
+    //value text according to the variable's declared type
+    for ( int i = 0; i < (int) bindingNames->size(); i++ ) {
+        string varName = bindingNames->at(i);
+        string valueText = bindingRow->at(i);
+        if ( symTable.count(varName) == 0 ) {
+            *out << "Error: binding for undeclared identifier " << varName << endl;
+            stop(0);
+        }
+        Heterogeneous &entry = symTable[varName];
+        //an array's entry holds its length, which a binding must not overwrite
+        if ( isArrayType(entry.type) ) {
+            *out << "Error: cannot bind a value to array " << varName << endl;
+            stop(0);
+        }
+        try {
+            if ( entry.type == "int" ) {
+                entry.value.iValue = stoi(valueText);
+            }
+            else if ( entry.type == "float" ) {
+                entry.value.fValue = stof(valueText);
+            }
+            else if ( entry.type == "bool" ) {
+                entry.value.bValue = valueText == "true" || valueText == "1";
+            }
+            else {
+                entry.value.cValue = valueText[0];
+            }
+        }
+        catch ( ... ) {
+            *out << "Error: bad initial value " << valueText << " for " << varName << endl;
+            stop(0);
+        }
+    }
+}
+
+/*
+ *=====================================
+ *     FCNS FOR EXECUTION GOVERNOR
+ *=====================================
+ */
+
+void stop (int status) {
+
+    if ( collectErrors ) {
+        noteError();
+    }
+
+    //inside a contained run an error ends only the current program; otherwise the process
+    if ( containedRun ) {
+        ProgramStop stopped = { status };
+        throw stopped;
+    }
+    measureMemory();
+    exit(status);
+}
+
+
+double elapsedMillis () {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - startTime).count();
+}
+
+
+void checkBudgets () {
+
+    //stop cleanly with a status that tells the caller which budget ran out
+    if ( loopIterations + stepCount > maxSteps ) {
+        *out << "Error: step budget of " << maxSteps << " exceeded" << endl;
+        stop(STEP_LIMIT_STATUS);
+    }
+    if ( maxMillis > 0 && elapsedMillis() > maxMillis ) {
+        *out << "Error: time limit of " << maxMillis << " ms exceeded" << endl;
+        stop(TIME_LIMIT_STATUS);
+    }
+}
+
+
+void reportStats () {
+
+    //runs at exit, so it covers error exits as well as normal completion
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double cpuMillis = usage.ru_utime.tv_sec * 1e3 + usage.ru_utime.tv_usec / 1e3 +
+        usage.ru_stime.tv_sec * 1e3 + usage.ru_stime.tv_usec / 1e3;
+    cout.flush();
+    cerr << "stats: statements " << stepCount << ", loop iterations " << loopIterations
+         << ", wall " << elapsedMillis() << " ms, cpu " << cpuMillis << " ms, peak rss "
+         << usage.ru_maxrss << " KB" << endl;
+    //the hit rate is the share of evaluations at already quickened sites whose guard held
+    if ( quickHits + quickMisses + quickDeopts > 0 ) {
+        cerr << "quickening: " << quickHits << " hits, " << quickMisses << " misses, "
+             << quickDeopts << " deopts, hit rate "
+             << ( quickHits + quickDeopts > 0 ? 100.0 * quickHits / ( quickHits + quickDeopts ) : 0.0 )
+             << "%" << endl;
+    }
+    if ( cacheOutcome != 0 ) {
+        cerr << "cache: " << ( cacheOutcome == CACHE_HIT ? "hit" : "miss" ) << ", totals "
+             << cacheHits << " hits, " << cacheMisses << " misses" << endl;
+    }
+}
+
+/*
+ *=====================================
+ *     FCNS FOR MEMORY ACCOUNTING
+ *=====================================
+ */
+
+//a red-black tree node carries a color and three links besides the entry itself
+const size_t MAP_NODE_BYTES = 4 * sizeof(void *);
+
+
+size_t heapBytes (const string &text) {
+
+    //short strings live inside the string object; longer ones allocate capacity + 1
+    static const size_t inlineCapacity = string().capacity();
+    return text.capacity() > inlineCapacity ? text.capacity() + 1 : 0;
+}
+
+
+size_t stringVectorBytes (const vector<string> *strings) {
+    if ( strings == 0 ) {
+        return 0;
+    }
+    size_t bytes = strings->capacity() * sizeof(string);
+    for ( int i = 0; i < (int) strings->size(); i++ ) {
+        bytes += heapBytes((*strings)[i]);
+    }
+    return bytes;
+}
+
+
+size_t tokenStorageBytes () {
+
+    //the token and lexeme vectors with their strings, and the decoded literal values
+    return stringVectorBytes(tokens) + stringVectorBytes(lexemes) +
+        ( tokenLiterals == 0 ? 0 : tokenLiterals->capacity() * sizeof(DecodedLiteral) );
+}
+
+
+long residentKB () {
+
+    //the second field of statm is the resident set size in pages
+    long pages = 0;
+    long resident = 0;
+    ifstream statm ("/proc/self/statm");
+    statm >> pages >> resident;
+    return resident * ( sysconf(_SC_PAGESIZE) / 1024 );
+}
+
+
+void recordPhase (const string &name) {
+    if ( !memStats ) {
+        return;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    //the kernel updates the high-water mark lazily, so it can lag the current size
+    long rss = residentKB();
+    MemPhase phase = { name, rss, max(rss, (long) usage.ru_maxrss) };
+    memPhases.push_back(phase);
+}
+
+
+void measureMemory () {
+
+    //the last phase ends here, at the end of main() or just before an error exits
+    if ( !memStats || memFigures.measured ) {
+        return;
+    }
+    recordPhase(memFinalPhase);
+    MemFigures &figures = memFigures;
+    figures.measured = true;
+    figures.tokens = tokens == 0 ? 0 : tokens->size();
+    figures.tokenBytes = stringVectorBytes(tokens);
+    figures.lexemeBytes = stringVectorBytes(lexemes);
+    figures.literalBytes = tokenLiterals == 0 ? 0 : tokenLiterals->capacity() * sizeof(DecodedLiteral);
+    figures.symbols = symTable.size();
+    figures.symbolBytes = 0;
+    for ( map<string, Heterogeneous>::iterator entry = symTable.begin(); entry != symTable.end(); ++entry ) {
+        figures.symbolBytes += MAP_NODE_BYTES + sizeof(*entry) + heapBytes(entry->first) +
+            heapBytes(entry->second.type);
+    }
+    figures.arrays = arrayTable.size();
+    figures.arrayBytes = 0;
+    for ( map<string, ArrayStorage>::iterator entry = arrayTable.begin(); entry != arrayTable.end(); ++entry ) {
+        figures.arrayBytes += MAP_NODE_BYTES + sizeof(*entry) + heapBytes(entry->first) +
+            heapBytes(entry->second.type) + entry->second.elements.capacity() * sizeof(Multivalue);
+    }
+    figures.siteBytes = quickSites.capacity() * sizeof(QuickSite);
+    figures.valuesLive = valuesLive;
+    figures.valuesPeak = valuesPeak;
+}
+
+
+void reportMemStats () {
+
+    //runs at exit; modes that return early (such as --compile-tokens) only have phases
+    const MemFigures &figures = memFigures;
+    double perToken = (double) ( figures.tokenBytes + figures.lexemeBytes + figures.literalBytes ) /
+        max(figures.tokens, (size_t) 1);
+    cout.flush();
+    if ( figures.measured ) {
+        cerr << "memory: " << figures.tokens << " tokens, " << perToken << " bytes per token" << endl;
+        cerr << "memory: tokens " << figures.tokenBytes << " B, lexemes " << figures.lexemeBytes
+             << " B, literals " << figures.literalBytes << " B, symbols " << figures.symbols << " ("
+             << figures.symbolBytes << " B), arrays " << figures.arrays << " (" << figures.arrayBytes
+             << " B), quickened sites " << figures.siteBytes << " B" << endl;
+        cerr << "memory: values live " << figures.valuesLive << ", peak " << figures.valuesPeak
+             << " (" << figures.valuesPeak * sizeof(Heterogeneous) << " B)" << endl;
+    }
+    for ( int i = 0; i < (int) memPhases.size(); i++ ) {
+        cerr << "memory: after " << memPhases[i].name << " rss " << memPhases[i].rssKB
+             << " KB, peak " << memPhases[i].peakKB << " KB" << endl;
+    }
+
+    if ( memJsonFile.empty() ) {
+        return;
+    }
+    ofstream json (memJsonFile.c_str());
+    json << "{\n  \"tokens\": " << figures.tokens << ",\n  \"bytesPerToken\": " << perToken
+         << ",\n  \"bytes\": { \"tokens\": " << figures.tokenBytes << ", \"lexemes\": "
+         << figures.lexemeBytes << ", \"literals\": " << figures.literalBytes << ", \"symbols\": "
+         << figures.symbolBytes << ", \"arrays\": " << figures.arrayBytes << ", \"quickenedSites\": "
+         << figures.siteBytes << " },\n  \"values\": { \"live\": " << figures.valuesLive
+         << ", \"peak\": " << figures.valuesPeak << ", \"bytesEach\": " << sizeof(Heterogeneous)
+         << " },\n  \"phases\": [";
+    for ( int i = 0; i < (int) memPhases.size(); i++ ) {
+        json << ( i == 0 ? "\n" : ",\n" ) << "    { \"name\": \"" << memPhases[i].name
+             << "\", \"rssKB\": " << memPhases[i].rssKB << ", \"peakKB\": "
+             << memPhases[i].peakKB << " }";
+    }
+    json << "\n  ]\n}" << endl;
+    if ( !json ) {
+        cerr << "Error: could not write " << memJsonFile << endl;
+    }
+}
+
+/*
+ *=====================================
+ *         FCNS FOR QUICKENING
+ *=====================================
+ */
+
+inline bool quickened (int site, int firstForm, int lastForm) {
+
+    //the site table is rebuilt whenever it does not match the tokens being run
+    if ( quickSites.size() != tokens->size() ) {
+        quickSites.assign(tokens->size(), QuickSite());
+    }
+
+    //only a form of the caller's own operator family stands for its operator token; a
+    //site quickened by another precedence level is some other operator
+    return site < (int) quickSites.size() && quickSites[site].form >= firstForm &&
+        quickSites[site].form <= lastForm;
+}
+
+
+inline unsigned char operandKind (const string &type) {
+
+    //the operators only single out these four types, and only they need a full compare
+    switch ( type.size() ) {
+        case 5:
+            return type == "float" ? OPERAND_FLOAT : OPERAND_OTHER;
+        case 11:
+            return type == "charLiteral" || type == "boolLiteral" ? OPERAND_CHAR_OR_BOOL :
+                OPERAND_OTHER;
+        case 12:
+            return type == "floatLiteral" ? OPERAND_FLOAT_LITERAL : OPERAND_OTHER;
+        default:
+            return OPERAND_OTHER;
+    }
+}
+
+
+void quicken (int site, unsigned char left, unsigned char right, int form) {
+    QuickSite &quick = quickSites[site];
+    quick.left = left;
+    quick.right = right;
+    quick.form = form;
+}
+
+
+inline bool runQuickened (int site, Heterogeneous &result, const Heterogeneous &temp) {
+
+    //a site that has not run yet, or whose operand kinds changed, takes the generic path
+    QuickSite &quick = quickSites[site];
+    if ( quick.form == QUICK_NONE ) {
+        quickMisses++;
+        return false;
+    }
+    if ( quick.left != operandKind(result.type) || quick.right != operandKind(temp.type) ) {
+        quickDeopts++;
+        return false;
+    }
+    quickHits++;
+
+    Multivalue &a = result.value;
+    const Multivalue &b = temp.value;
+    switch ( quick.form ) {
+        case QUICK_FLOAT_LT_FLOAT: a.bValue = a.fValue < b.fValue; break;
+        case QUICK_FLOAT_LE_FLOAT: a.bValue = a.fValue <= b.fValue; break;
+        case QUICK_FLOAT_GE_FLOAT: a.bValue = a.fValue >= b.fValue; break;
+        case QUICK_FLOAT_GT_FLOAT: a.bValue = a.fValue > b.fValue; break;
+        case QUICK_FLOAT_LT_INT: a.bValue = a.fValue < b.iValue; break;
+        case QUICK_FLOAT_LE_INT: a.bValue = a.fValue <= b.iValue; break;
+        case QUICK_FLOAT_GE_INT: a.bValue = a.fValue >= b.iValue; break;
+        case QUICK_FLOAT_GT_INT: a.bValue = a.fValue > b.iValue; break;
+        case QUICK_INT_LT_FLOAT: a.bValue = a.iValue < b.fValue; break;
+        case QUICK_INT_LE_FLOAT: a.bValue = a.iValue <= b.fValue; break;
+        case QUICK_INT_GE_FLOAT: a.bValue = a.iValue >= b.fValue; break;
+        case QUICK_INT_GT_FLOAT: a.bValue = a.iValue > b.fValue; break;
+        case QUICK_INT_LT_INT: a.bValue = a.iValue < b.iValue; break;
+        case QUICK_INT_LE_INT: a.bValue = a.iValue <= b.iValue; break;
+        case QUICK_INT_GE_INT: a.bValue = a.iValue >= b.iValue; break;
+        case QUICK_INT_GT_INT: a.bValue = a.iValue > b.iValue; break;
+        case QUICK_FLOAT_EQ_FLOAT: a.bValue = a.fValue == b.fValue; break;
+        case QUICK_FLOAT_NE_FLOAT: a.bValue = a.fValue != b.fValue; break;
+        case QUICK_FLOAT_EQ_INT: a.bValue = a.fValue == b.iValue; break;
+        case QUICK_FLOAT_NE_INT: a.bValue = a.fValue != b.iValue; break;
+        case QUICK_INT_EQ_FLOAT: a.bValue = a.iValue == b.fValue; break;
+        case QUICK_INT_NE_FLOAT: a.bValue = a.iValue != b.fValue; break;
+        case QUICK_INT_EQ_INT: a.bValue = a.iValue == b.iValue; break;
+        case QUICK_INT_NE_INT: a.bValue = a.iValue != b.iValue; break;
+        case QUICK_INT_ADD_INT: a.iValue = a.iValue + b.iValue; break;
+        case QUICK_INT_SUB_INT: a.iValue = a.iValue - b.iValue; break;
+        case QUICK_INT_ADD_FLOAT: a.fValue = a.iValue + b.fValue; break;
+        case QUICK_INT_SUB_FLOAT: a.fValue = a.iValue - b.fValue; break;
+        case QUICK_FLOAT_ADD_INT: a.fValue = a.fValue + b.iValue; break;
+        case QUICK_FLOAT_SUB_INT: a.fValue = a.fValue - b.iValue; break;
+    }
+
+    //comparisons give a bool; a float addition gives a float and an int one keeps its type
+    if ( quick.form < QUICK_INT_ADD_INT ) {
+        result.type = "bool";
+    }
+    else if ( quick.form > QUICK_INT_SUB_INT ) {
+        result.type = "float";
+    }
+    return true;
+}
+
+/*
+ *=====================================
+ *        FCNS FOR CHECKPOINTING
+ *=====================================
+ */
+
+uint64_t tokenStreamHash () {
+
+    //a checkpoint only fits the exact token stream it was taken from, after dead stores
+    //have been removed, since its frames hold token indices
+    uint64_t hash = checksum(0, 0);
+    for ( int i = 0; i < (int) tokens->size(); i++ ) {
+        const string &token = tokens->at(i);
+        const string &lexeme = lexemes->at(i);
+        hash = checksum((const unsigned char *) token.c_str(), token.size() + 1, hash);
+        hash = checksum((const unsigned char *) lexeme.c_str(), lexeme.size() + 1, hash);
+    }
+    return hash;
+}
+
+
+void writeCheckpoint () {
+
+    //header, counters, every open if/while frame, then every symbol with its raw value
+    string state (CHECKPOINT_MAGIC, 4);
+    uint32_t count = CHECKPOINT_VERSION;
+    state.append((const char *) &count, sizeof(count));
+    state.append((const char *) &programHash, sizeof(programHash));
+    state.append((const char *) &stepCount, sizeof(stepCount));
+    state.append((const char *) &loopIterations, sizeof(loopIterations));
+    count = execFrames.size();
+    state.append((const char *) &count, sizeof(count));
+    for ( int i = 0; i < (int) execFrames.size(); i++ ) {
+        int32_t fields[5] = { execFrames[i].keyword, execFrames[i].start, execFrames[i].end,
+            execFrames[i].body, ( execFrames[i].cond ? 1 : 0 ) | ( execFrames[i].inElse ? 2 : 0 ) };
+        state.append((const char *) fields, sizeof(fields));
+    }
+    count = symTable.size();
+    state.append((const char *) &count, sizeof(count));
+    for ( map<string, Heterogeneous>::iterator it = symTable.begin(); it != symTable.end(); ++it ) {
+        appendField(state, it->first);
+        appendField(state, it->second.type);
+        state.append((const char *) &it->second.value, sizeof(Multivalue));
+    }
+    //then the elements of every array, in name order like the symbols that hold their lengths
+    for ( map<string, ArrayStorage>::iterator it = arrayTable.begin(); it != arrayTable.end(); ++it ) {
+        state.append((const char *) &it->second.elements[0], it->second.elements.size() * sizeof(Multivalue));
+    }
+
+    //write next to the checkpoint and rename over it, so a crash never leaves half of one
+    string tempFile = checkpointFile + ".tmp";
+    ofstream written (tempFile.c_str(), ios::binary | ios::trunc);
+    written.write(state.data(), state.size());
+    written.close();
+    if ( !written.good() || rename(tempFile.c_str(), checkpointFile.c_str()) != 0 ) {
+        remove(tempFile.c_str());
+        cerr << "warning: could not write checkpoint " << checkpointFile << endl;
+    }
+    nextSuspend = loopIterations + checkpointEvery;
+}
+
+
+ExecFrame *resumeFrame (int keyword) {
+
+    //the next checkpointed frame, if execution is being resumed through this if/while
+    if ( resumeDepth < (int) resumeFrames.size() && resumeFrames[resumeDepth].keyword == keyword ) {
+        return &resumeFrames[resumeDepth++];
+    }
+    return 0;
+}
+
+
+bool resumeCheckpoint (const string &resumeFile) {
+
+    //no checkpoint yet means the run simply starts from the beginning
+    ifstream input (resumeFile.c_str(), ios::binary);
+    if ( !input ) {
+        return false;
+    }
+    string state ((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+    const char *field = state.data();
+    const char *end = field + state.size();
+
+    uint32_t version = 0;
+    uint64_t hash = 0;
+    uint32_t count = 0;
+    bool valid = state.size() >= 4 + sizeof(version) + sizeof(hash) + 2 * sizeof(long long) +
+        sizeof(count) && memcmp(field, CHECKPOINT_MAGIC, 4) == 0;
+    if ( valid ) {
+        field += 4;
+        memcpy(&version, field, sizeof(version));
+        field += sizeof(version);
+        memcpy(&hash, field, sizeof(hash));
+        field += sizeof(hash);
+        valid = version == CHECKPOINT_VERSION && hash == programHash;
+    }
+    if ( !valid ) {
+        *out << "Error: checkpoint " << resumeFile << " was not taken from this program" << endl;
+        stop(CHECKPOINT_ERROR_STATUS);
+    }
+
+    //counters carry on from where the checkpointed run stopped
+    memcpy(&stepCount, field, sizeof(stepCount));
+    field += sizeof(stepCount);
+    memcpy(&loopIterations, field, sizeof(loopIterations));
+    field += sizeof(loopIterations);
+    memcpy(&count, field, sizeof(count));
+    field += sizeof(count);
+
+    //every frame must sit on an 'if' or 'while' token of this stream, each one after the
+    //frame enclosing it, with the innermost a while; a while's condition starts at the '('
+    //right after its keyword, and every offset a frame resumes at must be a token of it
+    int32_t fields[5];
+    int size = tokens->size();
+    int enclosing = -1;
+    resumeFrames.clear();
+    for ( uint32_t i = 0; valid && i < count; i++ ) {
+        valid = field + sizeof(fields) <= end;
+        if ( valid ) {
+            memcpy(fields, field, sizeof(fields));
+            field += sizeof(fields);
+            ExecFrame frame = { fields[0], fields[1], fields[2], fields[3], ( fields[4] & 1 ) != 0,
+                ( fields[4] & 2 ) != 0 };
+            valid = frame.keyword > enclosing && frame.keyword < size &&
+                frame.body >= 0 && frame.body + 1 < size &&
+                frame.end >= 0 && frame.end < size && frame.start >= 0 && frame.start < size;
+            if ( valid && tokens->at(frame.keyword) == "while" ) {
+                valid = frame.start == frame.keyword + 1 && tokens->at(frame.start) == "(";
+            }
+            else if ( valid ) {
+                valid = tokens->at(frame.keyword) == "if";
+            }
+            enclosing = frame.keyword;
+            resumeFrames.push_back(frame);
+        }
+    }
+    valid = valid && !resumeFrames.empty() && tokens->at(resumeFrames.back().keyword) == "while";
+    if ( valid ) {
+        valid = field + sizeof(count) <= end;
+    }
+    if ( valid ) {
+        memcpy(&count, field, sizeof(count));
+        field += sizeof(count);
+    }
+    symTable.clear();
+    arrayTable.clear();
+    for ( uint32_t i = 0; valid && i < count; i++ ) {
+        string name;
+        Heterogeneous symbol;
+        valid = readField(field, end, name) && readField(field, end, symbol.type) &&
+            field + sizeof(Multivalue) <= end;
+        if ( valid ) {
+            memcpy(&symbol.value, field, sizeof(Multivalue));
+            field += sizeof(Multivalue);
+            symTable[name] = symbol;
+        }
+    }
+    for ( map<string, Heterogeneous>::iterator it = symTable.begin(); valid && it != symTable.end(); ++it ) {
+        const string &type = it->second.type;
+        if ( type.size() > 2 && type.compare(type.size() - 2, 2, "[]") == 0 ) {
+            size_t bytes = (size_t) it->second.value.iValue * sizeof(Multivalue);
+            valid = it->second.value.iValue > 0 && it->second.value.iValue <= MAX_ARRAY_LENGTH &&
+                bytes <= (size_t) ( end - field );
+            if ( valid ) {
+                allocateArray(it->first, it->second);
+                memcpy(&arrayTable[it->first].elements[0], field, bytes);
+                field += bytes;
+            }
+        }
+    }
+    if ( !valid ) {
+        *out << "Error: checkpoint " << resumeFile << " is corrupt" << endl;
+        stop(CHECKPOINT_ERROR_STATUS);
+    }
+
+    enterFrames();
+    return true;
+}
+
+
+void enterFrames () {
+
+    //re-entering the frames runs one statement() per frame, which the counter already has
+    stepCount -= resumeFrames.size();
+    resumeDepth = 0;
+    execFrames.clear();
+    currToken = resumeFrames[0].keyword - 1;
+}
+
+
+void suspendRun () {
+
+    //a scheduled program gives up the thread with its frames still in execFrames
+    if ( scheduling ) {
+        ProgramYield yielded;
+        throw yielded;
+    }
+
+    //a parallel region stops early once an earlier region has failed, since the
+    //sequential run would never have reached it
+    if ( parallelRegion >= 0 ) {
+        lock_guard<mutex> checking (parallelLock);
+        if ( parallelRegion > parallelFailed ) {
+            ProgramStop abandoned = { 0 };
+            throw abandoned;
+        }
+        nextSuspend = loopIterations + PARALLEL_POLL_ITERATIONS;
+        return;
+    }
+    writeCheckpoint();
+}
+
+/*
+ *=====================================
+ *        FCNS FOR EXECUTION TRACE
+ *=====================================
+ */
+
+bool startTrace (const string &traceFile) {
+
+    //records start right after the header; the header is written last, by finishTrace
+    traceFd = open(traceFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if ( traceFd < 0 ) {
+        return false;
+    }
+    traceRing = new TraceRecord[TRACE_RING_RECORDS];
+    traceFill = 0;
+    traceSlotOfToken = new vector<uint32_t> (tokens->size(), 0);
+    traceNames = new vector<string>;
+    traceMap = 0;
+    traceMapped = 0;
+    traceRecords = 0;
+    tracing = true;
+    atexit(finishTrace);
+    return true;
+}
+
+
+//append one record to the ring, spilling the ring to the trace file when it is full
+void traceAppend (const TraceRecord &record) {
+    traceRing[traceFill++] = record;
+    if ( traceFill == TRACE_RING_RECORDS ) {
+        spillTrace();
+    }
+}
+
+
+void traceBranch (TraceKind kind, int token, bool taken) {
+    TraceRecord record = { (uint8_t) kind, 'b', 0, (uint32_t) token, 0, 0, Multivalue() };
+    record.value.iValue = 0;
+    record.value.bValue = taken;
+    traceAppend(record);
+}
+
+
+void traceStore (TraceKind kind, int token, int index, const string &type, Multivalue value) {
+
+    //variables are numbered the first time each id token stores, so a store costs one
+    //vector lookup rather than a name lookup
+    uint32_t &slot = (*traceSlotOfToken)[token];
+    if ( slot == 0 ) {
+        const string &name = lexemes->at(token);
+        vector<string>::iterator known = find(traceNames->begin(), traceNames->end(), name);
+        slot = known - traceNames->begin() + 1;
+        if ( known == traceNames->end() ) {
+            traceNames->push_back(name);
+        }
+    }
+    TraceRecord record = { (uint8_t) kind, (uint8_t) ( type.empty() ? '?' : type[0] ), 0,
+        (uint32_t) token, slot - 1, index, value };
+    traceAppend(record);
+}
+
+void spillTrace () {
+
+    //grow the file and its mapping by doubling, then copy the ring in
+    size_t needed = sizeof(TraceHeader) + ( traceRecords + traceFill ) * sizeof(TraceRecord);
+    if ( needed > traceMapped ) {
+        size_t grown = max(needed, max(traceMapped * 2, (size_t) 1 << 20));
+        if ( traceMap != 0 ) {
+            munmap(traceMap, traceMapped);
+        }
+        void *mapped = MAP_FAILED;
+        if ( ftruncate(traceFd, grown) == 0 ) {
+            mapped = mmap(0, grown, PROT_READ | PROT_WRITE, MAP_SHARED, traceFd, 0);
+        }
+        if ( mapped == MAP_FAILED ) {
+            cerr << "warning: trace file could not grow; tracing stopped" << endl;
+            tracing = false;
+            traceMap = 0;
+            traceMapped = 0;
+            traceFill = 0;
+            return;
+        }
+        traceMap = (unsigned char *) mapped;
+        traceMapped = grown;
+    }
+    memcpy(traceMap + sizeof(TraceHeader) + traceRecords * sizeof(TraceRecord), traceRing,
+        traceFill * sizeof(TraceRecord));
+    traceRecords += traceFill;
+    traceFill = 0;
+}
+
+
+void finishTrace () {
+
+    //runs at exit, so a program stopped by an error or a budget still leaves a whole trace
+    if ( traceFd < 0 ) {
+        return;
+    }
+    if ( tracing && traceFill > 0 ) {
+        spillTrace();
+    }
+    if ( traceMap != 0 ) {
+        munmap(traceMap, traceMapped);
+    }
+    string names;
+    for ( int i = 0; i < (int) traceNames->size(); i++ ) {
+        appendField(names, traceNames->at(i));
+    }
+    TraceHeader header;
+    memcpy(header.magic, TRACE_MAGIC, 4);
+    header.version = TRACE_VERSION;
+    header.recordCount = traceRecords;
+    header.namesOffset = sizeof(header) + traceRecords * sizeof(TraceRecord);
+    header.slotCount = traceNames->size();
+    header.reserved = 0;
+    if ( ftruncate(traceFd, header.namesOffset) != 0 ||
+        pwrite(traceFd, names.data(), names.size(), header.namesOffset) != (ssize_t) names.size() ||
+        pwrite(traceFd, &header, sizeof(header), 0) != (ssize_t) sizeof(header) ) {
+        cerr << "warning: could not finish trace file" << endl;
+    }
+    close(traceFd);
+    traceFd = -1;
+    tracing = false;
+}
+
+
+int decodeTrace (const string &traceFile) {
+
+    size_t size = 0;
+    void *mapped = mapFile(traceFile, size);
+    const unsigned char *base = (const unsigned char *) mapped;
+    TraceHeader header;
+    bool valid = mapped != 0 && size >= sizeof(header);
+    if ( valid ) {
+        memcpy(&header, base, sizeof(header));
+        valid = memcmp(header.magic, TRACE_MAGIC, 4) == 0 && header.version == TRACE_VERSION &&
+            header.namesOffset == sizeof(header) + header.recordCount * sizeof(TraceRecord) &&
+            header.namesOffset <= size;
+    }
+    vector<string> names;
+    const char *field = (const char *) base + ( valid ? header.namesOffset : 0 );
+    for ( uint32_t i = 0; valid && i < header.slotCount; i++ ) {
+        names.push_back("");
+        valid = readField(field, (const char *) base + size, names.back());
+    }
+    if ( !valid ) {
+        cout << "Error: " << traceFile << " is not a complete trace file" << endl;
+        if ( mapped != 0 ) {
+            munmap(mapped, size);
+        }
+        return 1;
+    }
+
+    //one line per record: the statement's token index, then what happened
+    for ( uint64_t i = 0; i < header.recordCount; i++ ) {
+        TraceRecord record;
+        memcpy(&record, base + sizeof(header) + i * sizeof(record), sizeof(record));
+        cout << "token " << record.token << "  ";
+        if ( record.kind == TRACE_IF || record.kind == TRACE_WHILE ) {
+            cout << ( record.kind == TRACE_IF ? "if " : "while " )
+                 << ( record.value.bValue ? "true" : "false" ) << endl;
+            continue;
+        }
+        cout << ( record.slot < names.size() ? names[record.slot] : "?" );
+        if ( record.kind == TRACE_ELEMENT ) {
+            cout << "[" << record.index << "]";
+        }
+        cout << " = ";
+        if ( record.type == 'i' ) {
+            cout << record.value.iValue << endl;
+        }
+        else if ( record.type == 'f' ) {
+            cout << record.value.fValue << endl;
+        }
+        else if ( record.type == 'b' ) {
+            cout << record.value.bValue << endl;
+        }
+        else {
+            cout << record.value.cValue << endl;
+        }
+    }
+    munmap(mapped, size);
+    return 0;
+}
+
+/*
+ *=====================================
+ *         FCNS FOR SCHEDULING
+ *=====================================
+ */
+
+//one program being time-sliced: its own tokens, symbol table and counters, and the frames
+//it was executing when it last gave up the thread
+struct ScheduledProgram {
+    vector<string> *tokens;
+    vector<string> *lexemes;
+    vector<DecodedLiteral> *tokenLiterals;
+    map<string, Heterogeneous> symbols;
+    map<string, ArrayStorage> arrays;
+    vector<ExecFrame> frames;
+    vector<QuickSite> sites;
+    long long stepCount;
+    long long loopIterations;
+    bool started;
+    int status;
+    string output;
+    double micros;      //from the start of the schedule until the program finished
+};
+
+
+int runSchedule (const vector<string> &files, bool sourceInput) {
+
+    //load every program up front, each into its own token vectors
+    vector<ScheduledProgram> programs (files.size());
+    deque<int> ready;
+    for ( int i = 0; i < (int) files.size(); i++ ) {
+        ScheduledProgram &task = programs[i];
+        ostringstream captured;
+        out = &captured;
+        tokens = task.tokens = new vector<string>;
+        lexemes = task.lexemes = new vector<string>;
+        tokenLiterals = 0;
+        task.stepCount = 0;
+        task.loopIterations = 0;
+        task.started = false;
+        task.status = 0;
+        task.micros = 0;
+        if ( loadInput(files[i], sourceInput) ) {
+            eliminateDeadStores();
+            ready.push_back(i);
+        }
+        else {
+            task.status = LOAD_ERROR_STATUS;
+            delete task.tokens;
+            delete task.lexemes;
+            delete tokenLiterals;
+            task.tokens = 0;
+            task.lexemes = 0;
+            tokenLiterals = 0;
+        }
+        task.tokenLiterals = tokenLiterals;
+        task.output = captured.str();
+    }
+    out = &cout;
+
+    //round robin: run the program at the front for one slice, then put it at the back
+    //unless it finished; errors end only the program that made them
+    containedRun = true;
+    long long switches = 0;
+    startTime = chrono::steady_clock::now();
+    while ( !ready.empty() ) {
+        ScheduledProgram &task = programs[ready.front()];
+        ready.pop_front();
+        tokens = task.tokens;
+        lexemes = task.lexemes;
+        tokenLiterals = task.tokenLiterals;
+        symTable.swap(task.symbols);
+        arrayTable.swap(task.arrays);
+        quickSites.swap(task.sites);
+        stepCount = task.stepCount;
+        loopIterations = task.loopIterations;
+        nextSuspend = scheduleSlice > 0 ? loopIterations + scheduleSlice : LLONG_MAX;
+        ostringstream captured;
+        out = &captured;
+
+        bool yielded = false;
+        try {
+            if ( !task.started ) {
+                task.started = true;
+                currToken = -1;
+                program();
+            }
+            else {
+                resumeFrames.swap(task.frames);
+                enterFrames();
+                programStatements();
+            }
+        }
+        catch ( ProgramYield & ) {
+            yielded = true;
+            task.frames = execFrames;
+        }
+        catch ( ProgramStop &stopped ) {
+            task.status = stopped.status;
+        }
+        catch ( exception & ) {
+            task.status = 128 + SIGABRT;
+        }
+
+        task.output += captured.str();
+        symTable.swap(task.symbols);
+        arrayTable.swap(task.arrays);
+        quickSites.swap(task.sites);
+        task.stepCount = stepCount;
+        task.loopIterations = loopIterations;
+        if ( yielded ) {
+            ready.push_back(&task - &programs[0]);
+            switches++;
+        }
+        else {
+            task.micros = elapsedMillis() * 1e3;
+            task.symbols.clear();
+            task.arrays.clear();
+            task.sites.clear();
+            delete task.tokens;
+            delete task.lexemes;
+            delete task.tokenLiterals;
+            task.tokens = 0;
+            task.lexemes = 0;
+            task.tokenLiterals = 0;
+        }
+    }
+    out = &cout;
+    containedRun = false;
+    resumeFrames.clear();
+    execFrames.clear();
+    tokens = 0;
+    lexemes = 0;
+    tokenLiterals = 0;
+
+    //output in the order the files were given, then the latency distribution of the
+    //programs that ran (one that failed to load has no latency to report)
+    vector<double> latencies;
+    for ( int i = 0; i < (int) programs.size(); i++ ) {
+        cout << "program " << i + 1 << " (" << files[i] << "), status " << programs[i].status
+             << ":" << endl << programs[i].output;
+        if ( programs[i].started ) {
+            latencies.push_back(programs[i].micros);
+        }
+    }
+    sort(latencies.begin(), latencies.end());
+    int n = latencies.size();
+    cerr << "schedule: " << n << " programs run, " << programs.size() - n << " not loaded, slice "
+         << scheduleSlice << ", " << switches << " switches";
+    if ( n > 0 ) {
+        cerr << ", latency p50 " << latencies[( n - 1 ) / 2] << " us, p99 "
+             << latencies[( n - 1 ) * 99 / 100] << " us, max " << latencies[n - 1] << " us";
+    }
+    cerr << endl;
+    return 0;
+}
+
+/*
+ *=====================================
+ *        FCNS FOR SERVER MODE
+ *=====================================
+ */
+
+int runContained (const string &text, string &output) {
+
+    //recycle this thread's interpreter context: the token vectors keep their capacity
+    tokens->clear();
+    lexemes->clear();
+    delete tokenLiterals;
+    tokenLiterals = 0;
+
+    //a program is either a compiled token image or token/lexeme text
+    if ( text.size() >= 4 && memcmp(text.data(), TOKEN_IMAGE_MAGIC, 4) == 0 ) {
+        if ( !loadTokenImageBytes((const unsigned char *) text.data(), text.size()) ) {
+            output = "Error: corrupt or unsupported token image\n";
+            return 0;
+        }
+    }
+    else {
+        istringstream input (text);
+        readTokenText(input);
+        if ( tokens->empty() ) {
+            output = "Error: empty program\n";
+            return 0;
+        }
+    }
+    return runCaptured(output);
+}
+
+
+int runCaptured (string &output, bool prepass) {
+
+    //run the loaded tokens from a fresh symbol table, capturing the output and
+    //turning errors into an exit status instead of ending the process (a sweep runs
+    //the dead-store pass once itself, so its instances skip it)
+    ostringstream captured;
+    out = &captured;
+    containedRun = true;
+    symTable.clear();
+    arrayTable.clear();
+    stepCount = 0;
+    loopIterations = 0;
+    startTime = chrono::steady_clock::now();
+
+    int status = 0;
+    try {
+        if ( prepass ) {
+            eliminateDeadStores();
+        }
+        currToken = -1;
+        program();
+    }
+    catch ( ProgramStop &stopped ) {
+        status = stopped.status;
+    }
+    //running off the end of the token vector aborts a normal run
+    catch ( exception & ) {
+        status = 128 + SIGABRT;
+    }
+    out = &cout;
+    containedRun = false;
+    output = captured.str();
+    return status;
+}
+
+
+//one client stream of framed programs; responses go back in the order requests arrived
+struct Connection {
+    int outFd;
+    mutex lock;
+    condition_variable written;
+    map<long, string> finished;
+    long received;
+    long nextToWrite;
+    double totalMicros;
+};
+
+struct ServeJob {
+    shared_ptr<Connection> connection;
+    long id;
+    string program;
+    string rejected;        //error response for a request that was not read
+};
+
+//largest request the server will read; a longer one is skipped and answered with an error
+const long MAX_REQUEST_BYTES = 64L << 20;
+
+//--stats counters of every program the workers have run, added up as each one finishes
+mutex serveStatsLock;
+long long servedSteps;
+long long servedIterations;
+long long servedHits;
+long long servedMisses;
+long long servedDeopts;
+
+//queue of programs waiting for a worker
+mutex jobLock;
+condition_variable jobReady;
+deque<ServeJob> jobs;
+bool jobsClosed;
+
+
+void writeAll (int fd, const string &data) {
+    size_t done = 0;
+    while ( done < data.size() ) {
+        ssize_t count = write(fd, data.data() + done, data.size() - done);
+        if ( count <= 0 ) {
+            return;
+        }
+        done += count;
+    }
+}
+
+
+void serveWorker () {
+
+    //each worker owns one interpreter context for its whole life
+    tokens = new vector<string>;
+    lexemes = new vector<string>;
+    while ( true ) {
+        ServeJob job;
+        {
+            unique_lock<mutex> waiting (jobLock);
+            while ( jobs.empty() && !jobsClosed ) {
+                jobReady.wait(waiting);
+            }
+            if ( jobs.empty() ) {
+                break;
+            }
+            job = jobs.front();
+            jobs.pop_front();
+        }
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        string output = job.rejected;
+        int status = LOAD_ERROR_STATUS;
+        if ( job.rejected.empty() ) {
+            status = runContained(job.program, output);
+            lock_guard<mutex> counting (serveStatsLock);
+            servedSteps += stepCount;
+            servedIterations += loopIterations;
+        }
+        double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+        //a response is framed like a request: its byte length on a line, then the body
+        ostringstream body;
+        body << "id " << job.id << "\nstatus " << status << "\nmicros " << (long) micros << "\n" << output;
+        ostringstream frame;
+        frame << body.str().size() << "\n" << body.str();
+
+        Connection &connection = *job.connection;
+        lock_guard<mutex> holding (connection.lock);
+        connection.finished[job.id] = frame.str();
+        connection.totalMicros += micros;
+        while ( connection.finished.count(connection.nextToWrite) != 0 ) {
+            writeAll(connection.outFd, connection.finished[connection.nextToWrite]);
+            connection.finished.erase(connection.nextToWrite);
+            connection.nextToWrite++;
+        }
+        connection.written.notify_all();
+    }
+    delete tokens;
+    delete lexemes;
+    delete tokenLiterals;
+
+    //the quickening counters are never reset, so each worker hands its totals back once
+    lock_guard<mutex> counting (serveStatsLock);
+    servedHits += quickHits;
+    servedMisses += quickMisses;
+    servedDeopts += quickDeopts;
+}
+
+
+void serveConnection (int inFd, int outFd) {
+
+    shared_ptr<Connection> connection (new Connection());
+    connection->outFd = outFd;
+    connection->received = 0;
+    connection->nextToWrite = 0;
+    connection->totalMicros = 0;
+
+    //each request is its byte length in decimal on a line of its own, then that many bytes
+    FILE *in = fdopen(dup(inFd), "rb");
+    long length;
+    while ( in != 0 && fscanf(in, "%ld", &length) == 1 && getc(in) == '\n' && length >= 0 ) {
+        ServeJob job;
+        if ( length > MAX_REQUEST_BYTES ) {
+            //skip the body so the stream stays in step, and answer it with an error
+            char skipped[65536];
+            long left = length;
+            while ( left > 0 ) {
+                size_t count = fread(skipped, 1, min(left, (long) sizeof(skipped)), in);
+                if ( count == 0 ) {
+                    break;
+                }
+                left -= count;
+            }
+            if ( left > 0 ) {
+                break;
+            }
+            ostringstream rejected;
+            rejected << "Error: request of " << length << " bytes is over the limit of "
+                     << MAX_REQUEST_BYTES << " bytes" << endl;
+            job.rejected = rejected.str();
+        }
+        else {
+            job.program.assign(length, '\0');
+            if ( fread(&job.program[0], 1, length, in) != (size_t) length ) {
+                break;
+            }
+        }
+        job.connection = connection;
+        job.id = connection->received++;
+        lock_guard<mutex> queueing (jobLock);
+        jobs.push_back(job);
+        jobReady.notify_one();
+    }
+    if ( in != 0 ) {
+        fclose(in);
+    }
+
+    //wait for every response before reporting steady-state latency for this stream
+    unique_lock<mutex> waiting (connection->lock);
+    while ( connection->nextToWrite < connection->received ) {
+        connection->written.wait(waiting);
+    }
+    if ( connection->received > 0 ) {
+        cerr << "served " << connection->received << " programs, "
+             << connection->totalMicros / connection->received << " us per program" << endl;
+    }
+}
+
+
+void serve (const string &socketPath, int workers) {
+
+    //a client that hangs up early must not take the server down with it
+    signal(SIGPIPE, SIG_IGN);
+    vector<thread> pool;
+    for ( int i = 0; i < workers; i++ ) {
+        pool.push_back(thread(serveWorker));
+    }
+
+    //without a socket, serve the single stream on stdin/stdout and stop at its end
+    if ( socketPath.empty() ) {
+        serveConnection(0, 1);
+    }
+    else {
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+        unlink(socketPath.c_str());
+        if ( listener < 0 || ::bind(listener, (struct sockaddr *) &address, sizeof(address)) != 0 ||
+            listen(listener, 64) != 0 ) {
+            cout << "Error: could not listen on socket " << socketPath << endl;
+        }
+        else {
+            //every client connection is read on its own thread and served by the shared pool
+            int client;
+            while ( ( client = accept(listener, 0, 0) ) >= 0 ) {
+                thread([client] () {
+                    serveConnection(client, client);
+                    close(client);
+                }).detach();
+            }
+        }
+        if ( listener >= 0 ) {
+            close(listener);
+        }
+    }
+
+    {
+        lock_guard<mutex> closing (jobLock);
+        jobsClosed = true;
+    }
+    jobReady.notify_all();
+    for ( int i = 0; i < (int) pool.size(); i++ ) {
+        pool[i].join();
+    }
+    stepCount = servedSteps;
+    loopIterations = servedIterations;
+    quickHits = servedHits;
+    quickMisses = servedMisses;
+    quickDeopts = servedDeopts;
+}
+
+/*
+ *=====================================
+ *        FCNS FOR RESULT CACHE
+ *=====================================
+ */
+
+void countCacheOutcome (const string &cacheDir, int outcome) {
+
+    //the totals live in one small file, updated under an exclusive lock so concurrent
+    //processes never lose an increment
+    cacheOutcome = outcome;
+    string counterFile = cacheDir + "/counters";
+    int fd = open(counterFile.c_str(), O_RDWR | O_CREAT, 0644);
+    if ( fd < 0 ) {
+        return;
+    }
+    flock(fd, LOCK_EX);
+    char text[64] = { 0 };
+    ssize_t count = pread(fd, text, sizeof(text) - 1, 0);
+    if ( count <= 0 || sscanf(text, "%lld %lld", &cacheHits, &cacheMisses) != 2 ) {
+        cacheHits = 0;
+        cacheMisses = 0;
+    }
+    if ( outcome == CACHE_HIT )
+        cacheHits++;
+    else
+        cacheMisses++;
+    int length = snprintf(text, sizeof(text), "%lld %lld\n", cacheHits, cacheMisses);
+    if ( ftruncate(fd, 0) == 0 && pwrite(fd, text, length, 0) != length ) {
+        cerr << "warning: could not update cache counters" << endl;
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+}
+
+
+void evictCacheEntries (const string &cacheDir, long long cacheLimit) {
+
+    //least recently used first: a hit touches its entry, so mtime is the last use
+    DIR *dir = opendir(cacheDir.c_str());
+    if ( dir == 0 ) {
+        return;
+    }
+    vector< pair<time_t, string> > entries;
+    map<string, long long> sizes;
+    long long total = 0;
+    struct dirent *item;
+    while ( ( item = readdir(dir) ) != 0 ) {
+        string name = item->d_name;
+        struct stat info;
+        string path = cacheDir + "/" + name;
+        if ( name.size() > 4 && name.compare(name.size() - 4, 4, ".res") == 0 &&
+            stat(path.c_str(), &info) == 0 ) {
+            entries.push_back(make_pair(info.st_mtime, path));
+            sizes[path] = info.st_size;
+            total += info.st_size;
+        }
+    }
+    closedir(dir);
+    sort(entries.begin(), entries.end());
+    for ( int i = 0; i < (int) entries.size() && total > cacheLimit; i++ ) {
+        if ( unlink(entries[i].second.c_str()) == 0 ) {
+            total -= sizes[entries[i].second];
+        }
+    }
+}
+
+
+void raiseCachedTrap (int status) {
+
+    //a division by zero or running off the end of the tokens ends an uncached run with a
+    //signal, so a cached result of one ends the process the same way, hit or miss
+    if ( status == 128 + SIGFPE || status == 128 + SIGABRT ) {
+        cout << flush;
+        signal(status - 128, SIG_DFL);
+        raise(status - 128);
+    }
+}
+
+
+int runCached (const string &cacheDir, long long cacheLimit) {
+
+    //the key is two independent hashes of the normalized token/lexeme stream, plus the
+    //cache version and the budgets, since they can change the result
+    string normalized;
+    for ( int i = 0; i < (int) tokens->size(); i++ ) {
+        normalized += tokens->at(i);
+        normalized += '\t';
+        normalized += i < (int) lexemes->size() ? lexemes->at(i) : "";
+        normalized += '\n';
+    }
+    normalized += "version " + to_string(CACHE_VERSION) + " max-steps " + to_string(maxSteps) +
+        " max-ms " + to_string(maxMillis);
+    const unsigned char *bytes = (const unsigned char *) normalized.data();
+    char key[40];
+    snprintf(key, sizeof(key), "%016llx%016llx",
+        (unsigned long long) checksum(bytes, normalized.size()),
+        (unsigned long long) checksum(bytes, normalized.size(), 0x84222325cbf29ce4ULL));
+    mkdir(cacheDir.c_str(), 0755);
+    string entryFile = cacheDir + "/" + key + ".res";
+
+    //an entry is: status, output length, output bytes, then one line per symbol; an
+    //array's line ends with a tab and the bits of every element, eight hex digits each
+    ifstream entry (entryFile.c_str(), ios::binary);
+    int status;
+    size_t length;
+    if ( entry >> status >> length && entry.get() == '\n' ) {
+        string output (length, '\0');
+        if ( length == 0 || entry.read(&output[0], length) ) {
+            string name;
+            string type;
+            string bits;
+            while ( getline(entry, name, '\t') && getline(entry, type, '\t') && getline(entry, bits) ) {
+                Multivalue value;
+                value.iValue = (int) strtoul(bits.c_str(), 0, 16);
+                symTable[name] = Heterogeneous(type, value);
+                size_t tab = bits.find('\t');
+                if ( isArrayType(type) && tab != string::npos ) {
+                    allocateArray(name, symTable[name]);
+                    vector<Multivalue> &elements = arrayTable[name].elements;
+                    for ( size_t i = 0; i < elements.size() && tab + 8 * i + 8 < bits.size(); i++ ) {
+                        elements[i].iValue = (int) strtoul(bits.substr(tab + 1 + 8 * i, 8).c_str(), 0, 16);
+                    }
+                }
+            }
+            utime(entryFile.c_str(), 0);
+            countCacheOutcome(cacheDir, CACHE_HIT);
+            cout << output;
+            raiseCachedTrap(status);
+            return status;
+        }
+    }
+    entry.close();
+
+    //miss: run the program with its output captured, then publish the entry by writing a
+    //private temporary file and renaming it into place
+    string output;
+    cachedRun = true;
+    status = runCaptured(output);
+    cachedRun = false;
+    cout << output;
+    countCacheOutcome(cacheDir, CACHE_MISS);
+    if ( status == TIME_LIMIT_STATUS ) {
+        return status;
+    }
+    ostringstream tempName;
+    tempName << entryFile << ".tmp." << getpid();
+    ofstream written (tempName.str().c_str(), ios::binary | ios::trunc);
+    written << status << " " << output.size() << "\n" << output;
+    for ( map<string, Heterogeneous>::iterator symbol = symTable.begin(); symbol != symTable.end(); ++symbol ) {
+        char bits[16];
+        snprintf(bits, sizeof(bits), "%08x", (unsigned) symbol->second.value.iValue);
+        written << symbol->first << "\t" << symbol->second.type << "\t" << bits;
+        map<string, ArrayStorage>::iterator array = arrayTable.find(symbol->first);
+        if ( isArrayType(symbol->second.type) && array != arrayTable.end() ) {
+            written << "\t";
+            for ( size_t i = 0; i < array->second.elements.size(); i++ ) {
+                snprintf(bits, sizeof(bits), "%08x", (unsigned) array->second.elements[i].iValue);
+                written << bits;
+            }
+        }
+        written << "\n";
+    }
+    written.close();
+    if ( !written.good() || rename(tempName.str().c_str(), entryFile.c_str()) != 0 ) {
+        remove(tempName.str().c_str());
+    }
+    evictCacheEntries(cacheDir, cacheLimit);
+    raiseCachedTrap(status);
+    return status;
+}
+
+/*
+ *=====================================
+ *       FCNS FOR SOURCE LEXING
+ *=====================================
+ */
+
+//character classes for the lexer, looked up once per character
+enum CharClass { OTHER_CHAR, SPACE_CHAR, ALPHA_CHAR, DIGIT_CHAR };
+CharClass charClass[256];
+
+//keywords and the token each one produces
+map<string, string> keywordTokens;
+
+
+//spans, if given, receives the start and end offset of every token in text
+bool lexSource (const string &text, vector<uint32_t> *spans) {
+
+    //build the lookup tables on first use
+    if ( keywordTokens.empty() ) {
+        for ( int c = 0; c < 256; c++ ) {
+            if ( c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v' )
+                charClass[c] = SPACE_CHAR;
+            else if ( isalpha(c) || c == '_' )
+                charClass[c] = ALPHA_CHAR;
+            else if ( isdigit(c) )
+                charClass[c] = DIGIT_CHAR;
+            else
+                charClass[c] = OTHER_CHAR;
+        }
+        keywordTokens["int"] = "type";
+        keywordTokens["float"] = "type";
+        keywordTokens["bool"] = "type";
+        keywordTokens["char"] = "type";
+        keywordTokens["main"] = "main";
+        keywordTokens["if"] = "if";
+        keywordTokens["else"] = "else";
+        keywordTokens["while"] = "while";
+        keywordTokens["print"] = "print";
+        keywordTokens["return"] = "return";
+        keywordTokens["true"] = "boolLiteral";
+        keywordTokens["false"] = "boolLiteral";
+    }
+
+    const char *c = text.data();
+    const char *end = c + text.size();
+    while ( c < end ) {
+        CharClass cls = charClass[(unsigned char) *c];
+
+        //skip runs of whitespace and '//' comments
+        if ( cls == SPACE_CHAR ) {
+            c++;
+            continue;
+        }
+        if ( *c == '/' && c + 1 < end && c[1] == '/' ) {
+            while ( c < end && *c != '\n' ) {
+                c++;
+            }
+            continue;
+        }
+
+        const char *start = c;
+
+        //keywords and identifiers
+        if ( cls == ALPHA_CHAR ) {
+            while ( c < end && ( charClass[(unsigned char) *c] == ALPHA_CHAR ||
+                charClass[(unsigned char) *c] == DIGIT_CHAR ) ) {
+                c++;
+            }
+            string word (start, c);
+            map<string, string>::iterator keyword = keywordTokens.find(word);
+            tokens->push_back( keyword != keywordTokens.end() ? keyword->second : "id" );
+            lexemes->push_back( word );
+            if ( spans != 0 ) {
+                spans->push_back(start - text.data());
+                spans->push_back(c - text.data());
+            }
+            continue;
+        }
+
+        //int and float literals
+        if ( cls == DIGIT_CHAR ) {
+            while ( c < end && charClass[(unsigned char) *c] == DIGIT_CHAR ) {
+                c++;
+            }
+            string kind = "intLiteral";
+            if ( c + 1 < end && *c == '.' && charClass[(unsigned char) c[1]] == DIGIT_CHAR ) {
+                c++;
+                while ( c < end && charClass[(unsigned char) *c] == DIGIT_CHAR ) {
+                    c++;
+                }
+                kind = "floatLiteral";
+            }
+            tokens->push_back( kind );
+            lexemes->push_back( string(start, c) );
+            if ( spans != 0 ) {
+                spans->push_back(start - text.data());
+                spans->push_back(c - text.data());
+            }
+            continue;
+        }
+
+        //char literals such as 'a'; the lexeme is the character itself
+        if ( *c == '\'' ) {
+            if ( c + 2 >= end || c[2] != '\'' ) {
+                *out << "Error: malformed char literal in source" << endl;
+                return false;
+            }
+            tokens->push_back( "charLiteral" );
+            lexemes->push_back( string(1, c[1]) );
+            c += 3;
+            if ( spans != 0 ) {
+                spans->push_back(start - text.data());
+                spans->push_back(c - text.data());
+            }
+            continue;
+        }
+
+        //operators and punctuation, longest match first
+        char next = c + 1 < end ? c[1] : '\0';
+        string op;
+        string kind;
+        if ( ( *c == '<' || *c == '>' || *c == '=' || *c == '!' ) && next == '=' ) {
+            op = string(c, 2);
+            kind = ( *c == '=' || *c == '!' ) ? "equOp" : "relOp";
+        }
+        else if ( ( *c == '|' && next == '|' ) || ( *c == '&' && next == '&' ) ) {
+            op = string(c, 2);
+            kind = op;
+        }
+        else if ( *c == '<' || *c == '>' ) {
+            op = string(c, 1);
+            kind = "relOp";
+        }
+        else if ( *c == '=' ) {
+            op = "=";
+            kind = "assignOp";
+        }
+        else if ( *c == '+' || *c == '-' ) {
+            op = string(c, 1);
+            kind = "addOp";
+        }
+        else if ( *c == '*' || *c == '/' || *c == '%' ) {
+            op = string(c, 1);
+            kind = "multOp";
+        }
+        else if ( *c == '(' || *c == ')' || *c == '{' || *c == '}' || *c == ';' || *c == ',' ||
+            *c == '[' || *c == ']' ) {
+            op = string(c, 1);
+            kind = op;
+        }
+        else {
+            *out << "Error: unrecognized character '" << *c << "' in source" << endl;
+            return false;
+        }
+        tokens->push_back( kind );
+        lexemes->push_back( op );
+        c += op.size();
+        if ( spans != 0 ) {
+            spans->push_back(start - text.data());
+            spans->push_back(c - text.data());
+        }
+    }
+    return true;
+}
+
+/*
+ *=====================================
+ *   FCNS FOR DEAD-STORE ELIMINATION
+ *=====================================
+ */
+
+//kinds of statements recognized by the pre-pass scanner
+enum StmtKind { ASSIGN_STMT, PRINT_STMT, IF_STMT, WHILE_STMT, RETURN_STMT };
+
+//type error found by the scanner, with the index of the token it was found at
+struct Diagnostic {
+    int token;
+    string message;
+};
+
+//statement record built by the pre-pass scanner; indices refer to positions in the token vector
+struct StmtInfo {
+    StmtKind kind;
+    int start;                      //index of the statement's first token
+    int end;                        //index of the statement's last token
+    string target;                  //assigned id (assignment statements only)
+    bool element;                   //true if the target is one element of an array
+    set<string> uses;               //ids read anywhere in the statement
+    set<string> writes;             //ids assigned anywhere in the statement
+    bool safe;                      //true if evaluating the statement can never report an error
+    vector<Diagnostic> diagnostics; //type errors anywhere in the statement
+};
+
+//declared ids with their types, and ids declared more than once (those must keep their
+//declarations so that addSymbol still reports them)
+thread_local map<string, string> scanTypes;
+thread_local set<string> scanRedeclared;
+
+bool scanStatement (int &pos, StmtInfo &stmt);
+bool scanExpression (int &pos, StmtInfo &stmt, string &type);
+
+//return the token after 'pos' without consuming it, or "" at the end of the token vector
+string peekToken (int pos) {
+    if ( pos + 1 >= (int) tokens->size() ) {
+        return "";
+    }
+    return tokens->at(pos + 1);
+}
+
+
+void addDiagnostic (StmtInfo &stmt, int token, const string &message) {
+    Diagnostic found = { token, message };
+    stmt.diagnostics.push_back(found);
+}
+
+
+bool isCharOrBool (const string &type) {
+    return type == "char" || type == "bool";
+}
+
+
+bool isArrayType (const string &type) {
+    return type.size() > 2 && type.compare(type.size() - 2, 2, "[]") == 0;
+}
+
+
+bool scanIndex (int &pos, StmtInfo &stmt, string &type) {
+
+    //pos is at an array id followed by '['; the element type replaces the array type, and
+    //the index can always be out of bounds at run time
+    int idToken = pos;
+    stmt.safe = false;
+    pos++;
+    string indexType;
+    if ( !scanExpression(pos, stmt, indexType) || peekToken(pos) != "]" ) {
+        return false;
+    }
+    pos++;
+    if ( indexType != "int" ) {
+        addDiagnostic(stmt, idToken + 1, "array index must be an int");
+    }
+    if ( isArrayType(type) ) {
+        type = type.substr(0, type.size() - 2);
+    }
+    else if ( type != "" ) {
+        addDiagnostic(stmt, idToken, lexemes->at(idToken) + " is not an array");
+    }
+    return true;
+}
+
+
+bool scanFactor (int &pos, StmtInfo &stmt, string &type) {
+
+    string factor = peekToken(pos);
+    if ( factor == "id" ) {
+        pos++;
+        stmt.uses.insert(lexemes->at(pos));
+        //factor() reports an error for undeclared identifiers
+        map<string, string>::iterator declared = scanTypes.find(lexemes->at(pos));
+        if ( declared == scanTypes.end() ) {
+            stmt.safe = false;
+            addDiagnostic(stmt, pos, "use of undeclared identifier");
+            type = "";
+        }
+        else {
+            type = declared->second;
+        }
+        if ( peekToken(pos) == "[" ) {
+            return scanIndex(pos, stmt, type);
+        }
+        if ( isArrayType(type) ) {
+            stmt.safe = false;
+            addDiagnostic(stmt, pos, "array used without an index");
+        }
+        return true;
+    }
+    if ( factor == "intLiteral" || factor == "floatLiteral" ) {
+        pos++;
+        type = factor == "intLiteral" ? "int" : "float";
+        //stoi/stof throw on literals that are out of range
+        try {
+            if ( factor == "intLiteral" )
+                stoi(lexemes->at(pos));
+            else
+                stof(lexemes->at(pos));
+        }
+        catch ( ... ) {
+            stmt.safe = false;
+        }
+        return true;
+    }
+    if ( factor == "boolLiteral" || factor == "charLiteral" ) {
+        pos++;
+        type = factor == "boolLiteral" ? "bool" : "char";
+        return true;
+    }
+    if ( factor == "(" ) {
+        pos++;
+        if ( !scanExpression(pos, stmt, type) || peekToken(pos) != ")" ) {
+            return false;
+        }
+        pos++;
+        return true;
+    }
+    return false;
+}
+
+
+bool scanTerm (int &pos, StmtInfo &stmt, string &type) {
+
+    if ( !scanFactor(pos, stmt, type) ) {
+        return false;
+    }
+    while ( peekToken(pos) == "multOp" ) {
+        int opToken = ++pos;
+        //integer division or modulus by zero cannot be ruled out here
+        if ( lexemes->at(pos) == "/" || lexemes->at(pos) == "%" ) {
+            stmt.safe = false;
+        }
+        string right;
+        if ( !scanFactor(pos, stmt, right) ) {
+            return false;
+        }
+        if ( isCharOrBool(type) || isCharOrBool(right) ) {
+            addDiagnostic(stmt, opToken, "cannot perform *|/ on chars or bools");
+        }
+        type = type == "float" || right == "float" ? "float" : "int";
+    }
+    return true;
+}
+
+
+bool scanAddition (int &pos, StmtInfo &stmt, string &type) {
+
+    if ( !scanTerm(pos, stmt, type) ) {
+        return false;
+    }
+    while ( peekToken(pos) == "addOp" ) {
+        int opToken = ++pos;
+        string right;
+        if ( !scanTerm(pos, stmt, right) ) {
+            return false;
+        }
+        if ( isCharOrBool(type) || isCharOrBool(right) ) {
+            addDiagnostic(stmt, opToken, "cannot perform +|- on chars or bools");
+        }
+        type = type == "float" || right == "float" ? "float" : "int";
+    }
+    return true;
+}
+
+
+bool scanRelation (int &pos, StmtInfo &stmt, string &type) {
+
+    //relation and equality accept at most one operator, exactly like the grammar fcns
+    if ( !scanAddition(pos, stmt, type) ) {
+        return false;
+    }
+    if ( peekToken(pos) == "relOp" ) {
+        int opToken = ++pos;
+        string right;
+        if ( !scanAddition(pos, stmt, right) ) {
+            return false;
+        }
+        if ( isCharOrBool(type) || isCharOrBool(right) ) {
+            addDiagnostic(stmt, opToken, "cannot perform relative comparison on chars or bools");
+        }
+        type = "bool";
+    }
+    return true;
+}
+
+
+bool scanEquality (int &pos, StmtInfo &stmt, string &type) {
+
+    if ( !scanRelation(pos, stmt, type) ) {
+        return false;
+    }
+    if ( peekToken(pos) == "equOp" ) {
+        int opToken = ++pos;
+        string right;
+        if ( !scanRelation(pos, stmt, right) ) {
+            return false;
+        }
+        if ( isCharOrBool(type) || isCharOrBool(right) ) {
+            addDiagnostic(stmt, opToken, "cannot perform comparison on chars or bools");
+        }
+        type = "bool";
+    }
+    return true;
+}
+
+
+bool scanConjunction (int &pos, StmtInfo &stmt, string &type) {
+
+    if ( !scanEquality(pos, stmt, type) ) {
+        return false;
+    }
+    while ( peekToken(pos) == "&&" ) {
+        int opToken = ++pos;
+        //'&&' reports an error on non-boolean operands
+        stmt.safe = false;
+        string right;
+        if ( !scanEquality(pos, stmt, right) ) {
+            return false;
+        }
+        if ( type != "bool" || right != "bool" ) {
+            addDiagnostic(stmt, opToken, "cannot use logical operator '&&' on non-boolean types");
+        }
+        type = "bool";
+    }
+    return true;
+}
+
+
+bool scanExpression (int &pos, StmtInfo &stmt, string &type) {
+
+    if ( !scanConjunction(pos, stmt, type) ) {
+        return false;
+    }
+    while ( peekToken(pos) == "||" ) {
+        int opToken = ++pos;
+        //'||' reports an error on non-boolean operands
+        stmt.safe = false;
+        string right;
+        if ( !scanConjunction(pos, stmt, right) ) {
+            return false;
+        }
+        if ( type != "bool" || right != "bool" ) {
+            addDiagnostic(stmt, opToken, "cannot use logical operator '||' on non-boolean types");
+        }
+        type = "bool";
+    }
+    return true;
+}
+
+
+bool scanStatement (int &pos, StmtInfo &stmt) {
+
+    string stmtToken = peekToken(pos);
+    string type;
+    stmt.start = pos + 1;
+    stmt.safe = true;
+    stmt.element = false;
+
+    if ( stmtToken == "id" ) {
+        stmt.kind = ASSIGN_STMT;
+        pos++;
+        stmt.target = lexemes->at(pos);
+        stmt.writes.insert(stmt.target);
+        if ( peekToken(pos) == "[" ) {
+            map<string, string>::iterator declared = scanTypes.find(stmt.target);
+            string elementType = declared == scanTypes.end() ? "" : declared->second;
+            stmt.element = true;
+            if ( !scanIndex(pos, stmt, elementType) ) {
+                return false;
+            }
+        }
+        if ( peekToken(pos) != "assignOp" ) {
+            return false;
+        }
+        pos++;
+        if ( !scanExpression(pos, stmt, type) || peekToken(pos) != ";" ) {
+            return false;
+        }
+        pos++;
+    }
+    else if ( stmtToken == "print" || stmtToken == "return" ) {
+        stmt.kind = stmtToken == "print" ? PRINT_STMT : RETURN_STMT;
+        pos++;
+        if ( !scanExpression(pos, stmt, type) || peekToken(pos) != ";" ) {
+            return false;
+        }
+        pos++;
+    }
+    else if ( stmtToken == "if" || stmtToken == "while" ) {
+        stmt.kind = stmtToken == "if" ? IF_STMT : WHILE_STMT;
+        pos++;
+        if ( peekToken(pos) != "(" ) {
+            return false;
+        }
+        pos++;
+        if ( !scanExpression(pos, stmt, type) || peekToken(pos) != ")" ) {
+            return false;
+        }
+        pos++;
+        if ( type != "bool" ) {
+            addDiagnostic(stmt, pos, stmt.kind == IF_STMT ?
+                "must have boolean expression in if-statement condition" :
+                "must have boolean expression as while-statement condition");
+        }
+
+        //nested statements only contribute the ids they read and their type errors; their
+        //assignments are never removed since each one is the whole body of its if/while
+        for ( int branch = 0; branch < 2; branch++ ) {
+            StmtInfo body;
+            if ( !scanStatement(pos, body) ) {
+                return false;
+            }
+            stmt.uses.insert(body.uses.begin(), body.uses.end());
+            stmt.writes.insert(body.writes.begin(), body.writes.end());
+            stmt.diagnostics.insert(stmt.diagnostics.end(), body.diagnostics.begin(), body.diagnostics.end());
+            stmt.safe = stmt.safe && body.safe;
+            //only the first body can be followed by an 'else'; a second one is not part
+            //of this statement, just as ifStmt() leaves it unconsumed
+            if ( branch == 1 || stmt.kind != IF_STMT || peekToken(pos) != "else" ) {
+                break;
+            }
+            pos++;
+        }
+    }
+    else {
+        return false;
+    }
+    stmt.end = pos;
+    return true;
+}
+
+
+bool scanDeclarations (int &pos, vector<int> &declStarts, vector<int> &declEnds) {
+
+    //collect declared ids and their types, remembering where each declaration starts and
+    //ends; stops at the first declaration that does not parse
+    scanTypes.clear();
+    scanRedeclared.clear();
+    while ( peekToken(pos) == "type" ) {
+        declStarts.push_back(++pos);
+        string type = lexemes->at(pos);
+        while ( true ) {
+            if ( peekToken(pos) != "id" ) {
+                return false;
+            }
+            string id = lexemes->at(++pos);
+            string idType = type;
+            //an array id carries its length as '[' intLiteral ']'
+            if ( peekToken(pos) == "[" ) {
+                if ( peekToken(pos + 1) != "intLiteral" || peekToken(pos + 2) != "]" ) {
+                    return false;
+                }
+                pos += 3;
+                idType = type + "[]";
+            }
+            if ( scanTypes.count(id) != 0 ) {
+                scanRedeclared.insert(id);
+            }
+            else {
+                scanTypes[id] = idType;
+            }
+            if ( peekToken(pos) != "," ) {
+                break;
+            }
+            pos++;
+        }
+        if ( peekToken(pos) != ";" ) {
+            return false;
+        }
+        declEnds.push_back(++pos);
+    }
+    return true;
+}
+
+
+/*
+ *=====================================
+ *    FCNS FOR STATIC TYPE CHECKING
+ *=====================================
+ */
+
+//a check state file holds the results of the last incremental check: a header, the
+//declared types, the errors found in the header and declarations, one record per
+//top-level statement, the statements' errors, and finally a copy of the input bytes
+//the results were computed from, which the next run compares its input against
+const char CHECK_STATE_MAGIC[4] = { 'C', 'H', 'K', 'S' };
+const uint32_t CHECK_STATE_VERSION = 2;
+struct CheckStateHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t sourceInput;       //1 if the input was CLite source rather than tokens
+    uint32_t typeCount;
+    uint32_t earlyCount;        //errors in the declarations
+    uint32_t statementCount;
+    uint32_t diagnosticCount;
+    uint32_t tokenCount;
+    uint32_t declarationsEnd;   //byte just past the last declaration (or the '{')
+    uint32_t firstStatement;    //token index where the statements begin
+    int32_t missingBrace;       //token index of a missing '}' error, or -1
+    uint32_t reserved;
+    uint64_t inputBytes;
+};
+
+//one top-level statement: where its tokens are in the input, in bytes and in tokens, and
+//which of the saved errors are its own (their token indices are relative to its start)
+struct CheckedStatement {
+    uint32_t byteStart;
+    uint32_t byteEnd;
+    uint32_t tokenStart;
+    uint32_t tokenEnd;
+    uint32_t firstDiagnostic;
+    uint32_t diagnosticCount;
+};
+
+struct CheckState {
+    CheckStateHeader header;
+    map<string, string> types;
+    vector<Diagnostic> early;
+    vector<CheckedStatement> statements;
+    vector<Diagnostic> diagnostics;
+    const char *input;          //the input bytes the results belong to
+};
+
+
+vector<Diagnostic> checkStatementRange (int start, int end) {
+
+    //statements are checked on their own; nothing outside the range but the declared types
+    //can affect the result, so a statement's errors only move with it
+    StmtInfo stmt;
+    int pos = start - 1;
+    if ( !scanStatement(pos, stmt) || pos != end ) {
+        addDiagnostic(stmt, pos + 1, "syntax error in statement");
+    }
+    for ( int i = 0; i < (int) stmt.diagnostics.size(); i++ ) {
+        stmt.diagnostics[i].token -= start;
+    }
+    return stmt.diagnostics;
+}
+
+
+void checkStatementRanges (const vector< pair<int, int> > &ranges, vector< vector<Diagnostic> > &found) {
+
+    //the statements are checked in contiguous runs, one per thread; only the declared
+    //types are shared between statements, and each thread scans with its own copy (the
+    //vectors are reached through references because the globals are thread_local)
+    vector<string> &tokenText = *tokens;
+    vector<string> &lexemeText = *lexemes;
+    map<string, string> &declaredTypes = scanTypes;
+    int count = ranges.size();
+    int threads = max(1, min(checkThreads, count / CHECK_CHUNK_MIN));
+    found.assign(count, vector<Diagnostic>());
+    runOnThreads(threads, [&] (int c) {
+        if ( c > 0 ) {
+            tokens = &tokenText;
+            lexemes = &lexemeText;
+            scanTypes = declaredTypes;
+        }
+        int last = (long long) count * ( c + 1 ) / threads;
+        for ( int i = (long long) count * c / threads; i < last; i++ ) {
+            found[i] = checkStatementRange(ranges[i].first, ranges[i].second);
+        }
+    });
+}
+
+
+void splitStatements (int &pos, vector< pair<int, int> > &ranges) {
+
+    //statements contain no braces and no ';' except at their end, so a top-level
+    //statement ends at the first ';' that is not followed by 'else'
+    string next = peekToken(pos);
+    while ( next == "id" || next == "print" || next == "if" || next == "while" || next == "return" ) {
+        int start = pos + 1;
+        while ( peekToken(pos) != "" && peekToken(pos) != "}" ) {
+            pos++;
+            if ( tokens->at(pos) == ";" && peekToken(pos) != "else" ) {
+                break;
+            }
+        }
+        ranges.push_back(make_pair(start, pos));
+        next = peekToken(pos);
+    }
+}
+
+
+bool checkDeclarations (int &pos, vector<Diagnostic> &found) {
+
+    //the program header is checked exactly like programHeader() checks it; an error here
+    //is printed at once and ends the check
+    const char *header[] = { "type", "main", "(", ")", "{" };
+    const char *headerErrors[] = {
+        "'type' token missing for main function return value", "'main' token missing",
+        "'(' token missing in main function", "')' token missing in main function",
+        "'{' token missing at beginning of main function" };
+    for ( int i = 0; i < 5; i++ ) {
+        if ( peekToken(i - 1) != header[i] || lexemes->size() != tokens->size() ) {
+            *out << "Error: " << headerErrors[i] << " (token " << i << ")" << endl;
+            return false;
+        }
+    }
+
+    //declarations give every statement its types
+    pos = 4;
+    vector<int> declStarts;
+    vector<int> declEnds;
+    if ( !scanDeclarations(pos, declStarts, declEnds) ) {
+        *out << "Error: malformed declaration (token " << pos + 1 << ")" << endl;
+        return false;
+    }
+    set<string> seen;
+    for ( int t = 5; t <= pos; t++ ) {
+        if ( tokens->at(t) == "id" && !seen.insert(lexemes->at(t)).second ) {
+            Diagnostic redeclared = { t, lexemes->at(t) + " is already being used as an identifier" };
+            found.push_back(redeclared);
+        }
+    }
+    return true;
+}
+
+
+int checkProgram (bool showCounts) {
+
+    vector<Diagnostic> found;
+    int pos;
+    if ( !checkDeclarations(pos, found) ) {
+        return 1;
+    }
+
+    //check every top-level statement, then report the errors in source order
+    vector< pair<int, int> > ranges;
+    splitStatements(pos, ranges);
+    vector< vector<Diagnostic> > diagnostics;
+    checkStatementRanges(ranges, diagnostics);
+    for ( int i = 0; i < (int) ranges.size(); i++ ) {
+        for ( int d = 0; d < (int) diagnostics[i].size(); d++ ) {
+            Diagnostic located = { ranges[i].first + diagnostics[i][d].token, diagnostics[i][d].message };
+            found.push_back(located);
+        }
+    }
+    if ( peekToken(pos) != "}" ) {
+        Diagnostic missing = { pos + 1, "'}' token missing at end of main function" };
+        found.push_back(missing);
+    }
+
+    for ( int i = 0; i < (int) found.size(); i++ ) {
+        *out << "Error: " << found[i].message << " (token " << found[i].token << ")" << endl;
+    }
+    if ( showCounts ) {
+        cerr << "checked " << ranges.size() << " statements" << endl;
+    }
+    return found.empty() ? 0 : 1;
+}
+
+/*
+ *=====================================
+ *    FCNS FOR INCREMENTAL CHECKING
+ *=====================================
+ */
+
+void appendField (string &record, const string &text) {
+    uint32_t length = text.size();
+    record.append((const char *) &length, sizeof(length));
+    record += text;
+}
+
+
+//read one field of a serialized record, returning false if it runs past the end
+bool readField (const char *&field, const char *end, string &text) {
+    uint32_t length;
+    if ( field + sizeof(length) > end ) {
+        return false;
+    }
+    memcpy(&length, field, sizeof(length));
+    field += sizeof(length);
+    if ( length > (size_t) ( end - field ) ) {
+        return false;
+    }
+    text.assign(field, length);
+    field += length;
+    return true;
+}
+
+
+void appendDiagnostic (string &state, const Diagnostic &found) {
+    int32_t token = found.token;
+    state.append((const char *) &token, sizeof(token));
+    appendField(state, found.message);
+}
+
+
+bool readDiagnostic (const char *&field, const char *end, Diagnostic &found) {
+    int32_t token;
+    if ( field + sizeof(token) > end ) {
+        return false;
+    }
+    memcpy(&token, field, sizeof(token));
+    field += sizeof(token);
+    found.token = token;
+    return readField(field, end, found.message);
+}
+
+
+bool readCheckState (const char *base, size_t size, CheckState &state) {
+
+    //every count, offset and index is checked against the file and against each other
+    //before it is used; any state that does not hold together is ignored
+    const char *field = base;
+    const char *end = base + size;
+    CheckStateHeader &header = state.header;
+    if ( size < sizeof(header) ) {
+        return false;
+    }
+    memcpy(&header, field, sizeof(header));
+    field += sizeof(header);
+    if ( memcmp(header.magic, CHECK_STATE_MAGIC, 4) != 0 || header.version != CHECK_STATE_VERSION ||
+        header.inputBytes > size || header.declarationsEnd > header.inputBytes ||
+        header.firstStatement > header.tokenCount ) {
+        return false;
+    }
+    for ( uint32_t i = 0; i < header.typeCount; i++ ) {
+        string id;
+        string type;
+        if ( !readField(field, end, id) || !readField(field, end, type) ) {
+            return false;
+        }
+        state.types[id] = type;
+    }
+    for ( uint32_t i = 0; i < header.earlyCount; i++ ) {
+        Diagnostic found;
+        if ( !readDiagnostic(field, end, found) ) {
+            return false;
+        }
+        state.early.push_back(found);
+    }
+    if ( header.statementCount > (size_t) ( end - field ) / sizeof(CheckedStatement) ) {
+        return false;
+    }
+    state.statements.resize(header.statementCount);
+    memcpy(state.statements.data(), field, header.statementCount * sizeof(CheckedStatement));
+    field += header.statementCount * sizeof(CheckedStatement);
+    uint32_t byte = header.declarationsEnd;
+    uint32_t token = header.firstStatement;
+    for ( uint32_t i = 0; i < header.statementCount; i++ ) {
+        const CheckedStatement &stmt = state.statements[i];
+        if ( stmt.byteStart < byte || stmt.byteEnd <= stmt.byteStart || stmt.byteEnd > header.inputBytes ||
+            stmt.tokenStart < token || stmt.tokenEnd < stmt.tokenStart || stmt.tokenEnd >= header.tokenCount ||
+            stmt.firstDiagnostic > header.diagnosticCount ||
+            stmt.diagnosticCount > header.diagnosticCount - stmt.firstDiagnostic ) {
+            return false;
+        }
+        byte = stmt.byteEnd;
+        token = stmt.tokenEnd + 1;
+    }
+    for ( uint32_t i = 0; i < header.diagnosticCount; i++ ) {
+        Diagnostic found;
+        if ( !readDiagnostic(field, end, found) ) {
+            return false;
+        }
+        state.diagnostics.push_back(found);
+    }
+    if ( header.inputBytes != (uint64_t) ( end - field ) ) {
+        return false;
+    }
+    state.input = field;
+    return true;
+}
+
+
+bool writeCheckState (const string &stateFile, const CheckState &state, const char *input) {
+
+    //written to a temporary file and renamed into place, like the other saved files
+    string saved ((const char *) &state.header, sizeof(state.header));
+    for ( map<string, string>::const_iterator it = state.types.begin(); it != state.types.end(); ++it ) {
+        appendField(saved, it->first);
+        appendField(saved, it->second);
+    }
+    for ( int i = 0; i < (int) state.early.size(); i++ ) {
+        appendDiagnostic(saved, state.early[i]);
+    }
+    saved.append((const char *) state.statements.data(), state.statements.size() * sizeof(CheckedStatement));
+    for ( int i = 0; i < (int) state.diagnostics.size(); i++ ) {
+        appendDiagnostic(saved, state.diagnostics[i]);
+    }
+
+    string tempFile = stateFile + ".tmp";
+    ofstream written (tempFile.c_str(), ios::binary | ios::trunc);
+    written.write(saved.data(), saved.size());
+    written.write(input, state.header.inputBytes);
+    written.close();
+    if ( !written.good() || rename(tempFile.c_str(), stateFile.c_str()) != 0 ) {
+        remove(tempFile.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+void lexTokenWords (const char *begin, const char *end, vector<uint32_t> &spans) {
+
+    //split like readTokenText, also noting where each token word starts and where its
+    //lexeme word ends, relative to begin
+    bool lexeme = false;
+    const char *c = begin;
+    while ( true ) {
+        while ( c < end && isWordSpace(*c) ) {
+            c++;
+        }
+        if ( c == end ) {
+            break;
+        }
+        const char *start = c;
+        while ( c < end && !isWordSpace(*c) ) {
+            c++;
+        }
+        if ( lexeme ) {
+            lexemes->push_back( string(start, c) );
+            spans.push_back(c - begin);
+        }
+        else {
+            tokens->push_back( string(start, c) );
+            spans.push_back(start - begin);
+        }
+        lexeme = !lexeme;
+    }
+    if ( lexeme ) {
+        spans.push_back(c - begin);
+    }
+}
+
+
+bool lexWithSpans (const char *begin, const char *end, bool sourceInput, vector<uint32_t> &spans) {
+    if ( sourceInput ) {
+        return lexSource(string(begin, end), &spans);
+    }
+    lexTokenWords(begin, end, spans);
+    return true;
+}
+
+
+void addStatements (CheckState &state, const CheckState &from, int first, int last,
+    long long byteDelta, long long tokenDelta) {
+
+    //carry statements over from an earlier state, moved by the size of the edit before them
+    for ( int i = first; i < last; i++ ) {
+        CheckedStatement stmt = from.statements[i];
+        stmt.byteStart += byteDelta;
+        stmt.byteEnd += byteDelta;
+        stmt.tokenStart += tokenDelta;
+        stmt.tokenEnd += tokenDelta;
+        stmt.firstDiagnostic = state.diagnostics.size();
+        state.diagnostics.insert(state.diagnostics.end(), from.diagnostics.begin() +
+            from.statements[i].firstDiagnostic, from.diagnostics.begin() +
+            from.statements[i].firstDiagnostic + stmt.diagnosticCount);
+        state.statements.push_back(stmt);
+    }
+}
+
+
+void addCheckedRanges (CheckState &state, const vector< pair<int, int> > &ranges,
+    const vector<uint32_t> &spans, uint32_t byteBase, uint32_t tokenBase) {
+
+    //statements just checked: tokens and spans are relative to the start of the region
+    vector< vector<Diagnostic> > found;
+    checkStatementRanges(ranges, found);
+    for ( int i = 0; i < (int) ranges.size(); i++ ) {
+        CheckedStatement stmt = { byteBase + spans[2 * ranges[i].first], byteBase + spans[2 * ranges[i].second + 1],
+            tokenBase + ranges[i].first, tokenBase + ranges[i].second, (uint32_t) state.diagnostics.size(),
+            (uint32_t) found[i].size() };
+        state.diagnostics.insert(state.diagnostics.end(), found[i].begin(), found[i].end());
+        state.statements.push_back(stmt);
+    }
+}
+
+
+bool checkEdit (const CheckState &old, const char *text, size_t size, bool sourceInput,
+    CheckState &state, int &rechecked) {
+
+    //the unchanged parts of the input are its longest common prefix and suffix with the
+    //input the state was saved for
+    const char *previous = old.input;
+    size_t previousSize = old.header.inputBytes;
+    size_t common = min(size, previousSize);
+    size_t prefix = mismatch(text, text + common, previous).first - text;
+    size_t suffix = 0;
+    while ( suffix < common - prefix && text[size - 1 - suffix] == previous[previousSize - 1 - suffix] ) {
+        suffix++;
+    }
+
+    //an edit in the header or the declarations changes the types every statement sees
+    if ( old.header.sourceInput != ( sourceInput ? 1u : 0u ) || prefix <= old.header.declarationsEnd ) {
+        return false;
+    }
+
+    //a statement is kept if it and the bytes on either side of it are unchanged, since a
+    //changed neighbouring character could join onto its first or last token
+    const vector<CheckedStatement> &stmts = old.statements;
+    int count = stmts.size();
+    int kept = 0;
+    int lo = 0;
+    int hi = count;
+    while ( lo < hi ) {
+        int mid = ( lo + hi ) / 2;
+        if ( stmts[mid].byteEnd < prefix ) lo = mid + 1; else hi = mid;
+    }
+    kept = lo;
+    lo = kept;
+    hi = count;
+    while ( lo < hi ) {
+        int mid = ( lo + hi ) / 2;
+        if ( stmts[mid].byteStart > previousSize - suffix ) hi = mid; else lo = mid + 1;
+    }
+    int tail = lo;
+
+    //lex only the bytes between the kept statements
+    long long byteDelta = (long long) size - previousSize;
+    uint32_t byteBase = kept > 0 ? stmts[kept - 1].byteEnd : old.header.declarationsEnd;
+    size_t byteLimit = tail < count ? stmts[tail].byteStart + byteDelta : size;
+    uint32_t tokenBase = kept > 0 ? stmts[kept - 1].tokenEnd + 1 : old.header.firstStatement;
+    if ( byteLimit < byteBase ) {
+        return false;
+    }
+    //(a lexing error is left for the full check that follows to report)
+    vector<uint32_t> spans;
+    ostringstream unreported;
+    ostream *shown = out;
+    out = &unreported;
+    bool lexed = lexWithSpans(text + byteBase, text + byteLimit, sourceInput, spans);
+    out = shown;
+    if ( !lexed || lexemes->size() != tokens->size() ) {
+        return false;
+    }
+    int added = tokens->size();
+
+    //a '//' comment left open at the end of the region would swallow what follows it, a
+    //new declaration after the old ones would change the declared types, and an 'else'
+    //would join onto the statement before it
+    if ( sourceInput && tail < count ) {
+        string after (text + byteBase + ( added > 0 ? spans[2 * added - 1] : 0 ), text + byteLimit);
+        size_t comment = after.rfind("//");
+        if ( comment != string::npos && after.find('\n', comment) == string::npos ) {
+            return false;
+        }
+    }
+    if ( added > 0 && tokens->at(0) == ( kept == 0 ? "type" : "else" ) ) {
+        return false;
+    }
+
+    //the region must split into whole statements when more statements follow it
+    scanTypes = old.types;
+    int pos = -1;
+    vector< pair<int, int> > ranges;
+    splitStatements(pos, ranges);
+    if ( tail < count && ( pos != added - 1 || ( added > 0 && tokens->at(pos) != ";" ) ) ) {
+        return false;
+    }
+
+    uint32_t previousEnd = tail < count ? stmts[tail].tokenStart : old.header.tokenCount;
+    long long tokenDelta = (long long) added - ( previousEnd - tokenBase );
+    state.header = old.header;
+    state.types = old.types;
+    state.early = old.early;
+    addStatements(state, old, 0, kept, 0, 0);
+    addCheckedRanges(state, ranges, spans, byteBase, tokenBase);
+    addStatements(state, old, tail, count, byteDelta, tokenDelta);
+    if ( tail < count ) {
+        state.header.missingBrace = old.header.missingBrace < 0 ? -1 : old.header.missingBrace + tokenDelta;
+    }
+    else {
+        state.header.missingBrace = peekToken(pos) != "}" ? tokenBase + pos + 1 : -1;
+    }
+    state.header.tokenCount = old.header.tokenCount + tokenDelta;
+    rechecked = ranges.size();
+    return true;
+}
+
+
+bool checkWhole (const vector<uint32_t> &spans, bool sourceInput, CheckState &state) {
+
+    //check everything that was lexed, keeping the byte span of every statement
+    int pos;
+    if ( !checkDeclarations(pos, state.early) ) {
+        return false;
+    }
+    CheckStateHeader &header = state.header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECK_STATE_MAGIC, 4);
+    header.version = CHECK_STATE_VERSION;
+    header.sourceInput = sourceInput ? 1 : 0;
+    header.declarationsEnd = spans[2 * pos + 1];
+    header.firstStatement = pos + 1;
+    state.types = scanTypes;
+    vector< pair<int, int> > ranges;
+    splitStatements(pos, ranges);
+    addCheckedRanges(state, ranges, spans, 0, 0);
+    header.missingBrace = peekToken(pos) != "}" ? pos + 1 : -1;
+    header.tokenCount = tokens->size();
+    return true;
+}
+
+
+int checkIncremental (const string &argFile, bool sourceInput, const string &stateFile) {
+
+    //token images, and inputs too large for the state's 32-bit offsets, are checked whole
+    size_t size = 0;
+    void *mapped = mapFile(argFile, size);
+    if ( mapped == 0 || size < 4 || memcmp(mapped, TOKEN_IMAGE_MAGIC, 4) == 0 || size > UINT32_MAX ) {
+        if ( mapped != 0 ) {
+            munmap(mapped, size);
+        }
+        if ( !loadInput(argFile, sourceInput) ) {
+            return 0;
+        }
+        return checkProgram(true);
+    }
+    const char *text = (const char *) mapped;
+
+    //re-check only the statements an edit touched when the saved state allows it
+    CheckState old;
+    CheckState state;
+    int rechecked = 0;
+    size_t stateSize = 0;
+    void *stateMap = mapFile(stateFile, stateSize);
+    bool edited = stateMap != 0 && readCheckState((const char *) stateMap, stateSize, old) &&
+        checkEdit(old, text, size, sourceInput, state, rechecked);
+    if ( !edited ) {
+        vector<uint32_t> spans;
+        state = CheckState();
+        tokens->clear();
+        lexemes->clear();
+        bool lexed = lexWithSpans(text, text + size, sourceInput, spans);
+        if ( !lexed || !checkWhole(spans, sourceInput, state) ) {
+            if ( stateMap != 0 ) {
+                munmap(stateMap, stateSize);
+            }
+            munmap(mapped, size);
+            return lexed ? 1 : 0;
+        }
+        rechecked = state.statements.size();
+    }
+    state.header.typeCount = state.types.size();
+    state.header.earlyCount = state.early.size();
+    state.header.statementCount = state.statements.size();
+    state.header.diagnosticCount = state.diagnostics.size();
+    state.header.inputBytes = size;
+
+    //report in source order: declarations, each statement, then a missing '}'
+    int errors = state.early.size();
+    for ( int i = 0; i < (int) state.early.size(); i++ ) {
+        *out << "Error: " << state.early[i].message << " (token " << state.early[i].token << ")" << endl;
+    }
+    for ( int i = 0; i < (int) state.statements.size(); i++ ) {
+        const CheckedStatement &stmt = state.statements[i];
+        for ( uint32_t d = stmt.firstDiagnostic; d < stmt.firstDiagnostic + stmt.diagnosticCount; d++ ) {
+            *out << "Error: " << state.diagnostics[d].message << " (token "
+                 << stmt.tokenStart + state.diagnostics[d].token << ")" << endl;
+            errors++;
+        }
+    }
+    if ( state.header.missingBrace >= 0 ) {
+        *out << "Error: '}' token missing at end of main function (token "
+             << state.header.missingBrace << ")" << endl;
+        errors++;
+    }
+    cerr << "checked " << state.statements.size() << " statements, " << rechecked << " re-checked, "
+         << state.statements.size() - rechecked << " reused" << endl;
+
+    if ( stateMap != 0 ) {
+        munmap(stateMap, stateSize);
+    }
+    if ( !writeCheckState(stateFile, state, text) ) {
+        cerr << "warning: could not save check state " << stateFile << endl;
+    }
+    munmap(mapped, size);
+    return errors > 0 ? 1 : 0;
+}
+
+
+void eliminateDeadStores () {
+
+    //the scan mirrors program(); if anything does not parse, leave the tokens untouched
+    //so the grammar fcns report the error exactly as before
+    int pos = 4;
+    if ( tokens->size() < 6 || lexemes->size() != tokens->size() || tokens->at(0) != "type" || tokens->at(1) != "main" ||
+        tokens->at(2) != "(" || tokens->at(3) != ")" || tokens->at(4) != "{" ) {
+        return;
+    }
+
+    //collect declared ids, remembering where each declaration starts and ends
+    vector<int> declStarts;
+    vector<int> declEnds;
+    if ( !scanDeclarations(pos, declStarts, declEnds) ) {
+        return;
+    }
+
+    //scan the top-level statements
+    vector<StmtInfo> stmts;
+    string next = peekToken(pos);
+    while ( next == "id" || next == "print" || next == "if" || next == "while" || next == "return" ) {
+        StmtInfo stmt;
+        if ( !scanStatement(pos, stmt) ) {
+            return;
+        }
+        stmts.push_back(stmt);
+        next = peekToken(pos);
+    }
+    if ( next != "}" ) {
+        return;
+    }
+
+    //walk the statements backwards keeping the set of live ids; a top-level assignment
+    //to an id that is not live afterwards is dead if evaluating it cannot report an error
+    vector<bool> keep (tokens->size(), true);
+    set<string> live;
+    for ( int i = stmts.size() - 1; i >= 0; i-- ) {
+        StmtInfo &stmt = stmts[i];
+        if ( stmt.kind == ASSIGN_STMT ) {
+            if ( live.count(stmt.target) == 0 && stmt.safe ) {
+                for ( int t = stmt.start; t <= stmt.end; t++ ) {
+                    keep[t] = false;
+                }
+                continue;
+            }
+            //writing one element leaves the rest of the array live
+            if ( !stmt.element ) {
+                live.erase(stmt.target);
+            }
+        }
+        //if/while bodies may run any number of times, so they never kill an id
+        live.insert(stmt.uses.begin(), stmt.uses.end());
+    }
+
+    //an id is still needed if any remaining statement mentions it, or if a parameter
+    //sweep gives it an initial value
+    set<string> referenced;
+    if ( bindingNames != 0 ) {
+        referenced.insert(bindingNames->begin(), bindingNames->end());
+    }
+    for ( int t = declEnds.empty() ? 5 : declEnds.back() + 1; t <= pos; t++ ) {
+        if ( keep[t] && tokens->at(t) == "id" ) {
+            referenced.insert(lexemes->at(t));
+        }
+    }
+
+    //rebuild each declaration from the ids still needed, keeping only the commas
+    //between them; a declaration with no ids left loses its 'type' and ';' too
+    for ( int d = 0; d < (int) declStarts.size(); d++ ) {
+        bool anyKept = false;
+        for ( int t = declStarts[d] + 1; t < declEnds[d]; t++ ) {
+            if ( tokens->at(t) == "," ) {
+                keep[t] = false;
+                continue;
+            }
+            string id = lexemes->at(t);
+            //an array id is kept or dropped together with its '[' length ']'
+            int last = tokens->at(t + 1) == "[" ? t + 3 : t;
+            if ( referenced.count(id) == 0 && scanRedeclared.count(id) == 0 ) {
+                for ( ; t <= last; t++ ) {
+                    keep[t] = false;
+                }
+                t--;
+                continue;
+            }
+            if ( anyKept ) {
+                keep[t - 1] = true;
+            }
+            anyKept = true;
+            t = last;
+        }
+        if ( !anyKept ) {
+            keep[declStarts[d]] = false;
+            keep[declEnds[d]] = false;
+        }
+    }
+
+    //compact the token and lexeme vectors in place
+    int kept = 0;
+    for ( int t = 0; t < (int) tokens->size(); t++ ) {
+        if ( keep[t] ) {
+            (*tokens)[kept] = (*tokens)[t];
+            (*lexemes)[kept] = (*lexemes)[t];
+            if ( tokenLiterals != 0 ) {
+                (*tokenLiterals)[kept] = (*tokenLiterals)[t];
+            }
+            kept++;
+        }
+    }
+    tokens->resize(kept);
+    lexemes->resize(kept);
+    if ( tokenLiterals != 0 ) {
+        tokenLiterals->resize(kept);
+    }
+}
+
+/*
+ *=====================================
+ *     FCNS FOR ERROR RECOVERY
+ *=====================================
+ */
+
+int runCollectingErrors () {
+
+    //the dead-store pass is skipped so that token indices are those of the input file
+    out = &collectedOut;
+    containedRun = true;
+    int status = 0;
+    try {
+        currToken = -1;
+        program();
+    }
+    //errors in the program header, a missing '}', and budgets end the run
+    catch ( ProgramStop &stopped ) {
+        status = stopped.status;
+    }
+    catch ( exception & ) {
+        *out << "Error: unexpected end of input" << endl;
+        currToken = tokens->size();
+        noteError();
+    }
+    containedRun = false;
+    out = &cout;
+    cout << collectedOut.str() << flush;
+    collectedOut.str("");
+
+    //one summary line for scripts: the error count and where each error was found
+    cerr << "errors " << errorTokens.size() << " tokens";
+    for ( int i = 0; i < (int) errorTokens.size(); i++ ) {
+        cerr << ( i == 0 ? " " : "," ) << errorTokens[i];
+    }
+    cerr << endl;
+    if ( status == STEP_LIMIT_STATUS || status == TIME_LIMIT_STATUS ) {
+        return status;
+    }
+    return errorTokens.empty() ? 0 : 1;
+}
+
+
+void runRecovering (bool isStatement) {
+
+    //a declaration starts at its 'type' token (already consumed), a statement after it
+    int start = isStatement ? currToken + 1 : currToken;
+    try {
+        if ( isStatement ) {
+            statement(true);
+        }
+        else {
+            declaration();
+        }
+    }
+    catch ( ProgramStop &stopped ) {
+        if ( stopped.status == STEP_LIMIT_STATUS || stopped.status == TIME_LIMIT_STATUS ) {
+            throw;
+        }
+
+        //panic mode: skip to the first ';' (not followed by 'else') at or after the error,
+        //or to just before a '}', and carry on from there
+        execFrames.clear();
+        int t = max(currToken, start);
+        while ( t < (int) tokens->size() && tokens->at(t) != "}" && ( tokens->at(t) != ";" ||
+            ( t + 1 < (int) tokens->size() && tokens->at(t + 1) == "else" ) ) ) {
+            t++;
+        }
+        currToken = t < (int) tokens->size() && tokens->at(t) == ";" ? t : t - 1;
+    }
+    cout << collectedOut.str();
+    collectedOut.str("");
+}
+
+
+void noteError () {
+
+    //the message is the last line written: print the output before it unchanged, then the
+    //message with the index of the token the error was found at
+    string text = collectedOut.str();
+    size_t end = text.size();
+    if ( end > 0 && text[end - 1] == '\n' ) {
+        end--;
+    }
+    size_t start = end == 0 ? string::npos : text.rfind('\n', end - 1);
+    start = start == string::npos ? 0 : start + 1;
+    cout << text.substr(0, start) << text.substr(start, end - start) << " (token " << currToken
+         << ")" << endl;
+    collectedOut.str("");
+    errorTokens.push_back(currToken);
+}
+
+/*
+ *=====================================
+ *    FCNS FOR PARALLEL EXECUTION
+ *=====================================
+ */
+
+//a run of consecutive top-level statements executed as one task, the ids it reads or
+//writes, and the regions that must finish before it can start
+struct Region {
+    int start;                  //first token of the first statement
+    int end;                    //last token of the last statement
+    set<string> ids;
+    set<string> writes;
+    vector<int> dependents;
+    int waitingOn;
+    int status;
+    bool failed;
+    bool stuck;                 //a statement in it consumed no tokens
+    exception_ptr error;        //what ended the region, if it ran off the token vector
+    string output;
+};
+
+
+void runRegion (Region &region, int index, map<string, Heterogeneous> &shared,
+    map<string, ArrayStorage> &sharedArrays) {
+
+    //copy the region's ids in from the shared tables; the dependency graph guarantees that
+    //no region running at the same time writes any of them
+    symTable.clear();
+    arrayTable.clear();
+    {
+        lock_guard<mutex> copying (parallelLock);
+        for ( set<string>::iterator id = region.ids.begin(); id != region.ids.end(); ++id ) {
+            map<string, Heterogeneous>::iterator symbol = shared.find(*id);
+            if ( symbol != shared.end() ) {
+                symTable[*id] = symbol->second;
+            }
+            map<string, ArrayStorage>::iterator array = sharedArrays.find(*id);
+            if ( array != sharedArrays.end() ) {
+                arrayTable[*id] = array->second;
+            }
+        }
+    }
+
+    ostringstream captured;
+    out = &captured;
+    parallelRegion = index;
+    nextSuspend = loopIterations + PARALLEL_POLL_ITERATIONS;
+    region.status = 0;
+    region.failed = false;
+    region.stuck = false;
+    try {
+        //a token statement() does not consume would otherwise be retried forever; the
+        //region is given up and the whole program is run sequentially instead
+        currToken = region.start - 1;
+        while ( currToken < region.end ) {
+            int before = currToken;
+            statement(true);
+            if ( currToken == before ) {
+                region.stuck = true;
+                region.failed = true;
+                break;
+            }
+        }
+    }
+    catch ( ProgramStop &stopped ) {
+        region.status = stopped.status;
+        region.failed = true;
+    }
+    catch ( exception & ) {
+        region.status = 128 + SIGABRT;
+        region.failed = true;
+        region.error = current_exception();
+    }
+    parallelRegion = -1;
+    out = &cout;
+    region.output = captured.str();
+
+    //publish what the region wrote (an assignment to an undeclared id creates it, exactly
+    //as in a sequential run)
+    lock_guard<mutex> copying (parallelLock);
+    for ( set<string>::iterator id = region.writes.begin(); id != region.writes.end(); ++id ) {
+        map<string, Heterogeneous>::iterator symbol = symTable.find(*id);
+        if ( symbol != symTable.end() ) {
+            shared[*id] = symbol->second;
+        }
+        map<string, ArrayStorage>::iterator array = arrayTable.find(*id);
+        if ( array != arrayTable.end() ) {
+            sharedArrays[*id].elements.swap(array->second.elements);
+        }
+    }
+    if ( region.failed ) {
+        parallelFailed = min(parallelFailed, index);
+    }
+}
+
+
+int runParallel (int workers) {
+
+    //declarations run as usual; then the statements are scanned for their read and write
+    //sets, and anything the scanner cannot follow is simply run sequentially
+    currToken = -1;
+    programHeader();
+    int pos = currToken;
+    int firstStatement = pos;
+    vector<StmtInfo> stmts;
+    string next = peekToken(pos);
+    while ( next == "id" || next == "print" || next == "if" || next == "while" || next == "return" ) {
+        StmtInfo stmt;
+        if ( !scanStatement(pos, stmt) ) {
+            break;
+        }
+        stmts.push_back(stmt);
+        next = peekToken(pos);
+    }
+    if ( next != "}" || stmts.empty() ) {
+        programStatements();
+        return 0;
+    }
+
+    //a statement depends on the last earlier statement that wrote an id it touches, and a
+    //write also depends on every statement that read the id since that write
+    vector< set<int> > dependsOn (stmts.size());
+    map<string, int> lastWriter;
+    map<string, vector<int> > readersSince;
+    for ( int i = 0; i < (int) stmts.size(); i++ ) {
+        StmtInfo &stmt = stmts[i];
+        set<string> ids (stmt.uses);
+        ids.insert(stmt.writes.begin(), stmt.writes.end());
+        for ( set<string>::iterator id = ids.begin(); id != ids.end(); ++id ) {
+            map<string, int>::iterator writer = lastWriter.find(*id);
+            if ( writer != lastWriter.end() ) {
+                dependsOn[i].insert(writer->second);
+            }
+            if ( stmt.writes.count(*id) != 0 ) {
+                vector<int> &readers = readersSince[*id];
+                dependsOn[i].insert(readers.begin(), readers.end());
+                readers.clear();
+                lastWriter[*id] = i;
+            }
+            else {
+                readersSince[*id].push_back(i);
+            }
+        }
+    }
+
+    //a statement that depends on the one just before it joins that statement's region, so
+    //chains of dependent statements do not pay for a task each
+    vector<Region> regions;
+    vector<int> regionOf (stmts.size());
+    for ( int i = 0; i < (int) stmts.size(); i++ ) {
+        if ( i == 0 || dependsOn[i].count(i - 1) == 0 ) {
+            Region region;
+            region.start = stmts[i].start;
+            region.waitingOn = 0;
+            regions.push_back(region);
+        }
+        Region &region = regions.back();
+        region.end = stmts[i].end;
+        region.ids.insert(stmts[i].uses.begin(), stmts[i].uses.end());
+        region.ids.insert(stmts[i].writes.begin(), stmts[i].writes.end());
+        region.writes.insert(stmts[i].writes.begin(), stmts[i].writes.end());
+        regionOf[i] = regions.size() - 1;
+    }
+    vector< set<int> > regionDeps (regions.size());
+    for ( int i = 0; i < (int) stmts.size(); i++ ) {
+        for ( set<int>::iterator dep = dependsOn[i].begin(); dep != dependsOn[i].end(); ++dep ) {
+            if ( regionOf[*dep] != regionOf[i] ) {
+                regionDeps[regionOf[i]].insert(regionOf[*dep]);
+            }
+        }
+    }
+    deque<int> ready;
+    for ( int r = 0; r < (int) regions.size(); r++ ) {
+        regions[r].waitingOn = regionDeps[r].size();
+        for ( set<int>::iterator dep = regionDeps[r].begin(); dep != regionDeps[r].end(); ++dep ) {
+            regions[*dep].dependents.push_back(r);
+        }
+        if ( regions[r].waitingOn == 0 ) {
+            ready.push_back(r);
+        }
+    }
+
+    //workers take ready regions in program order; finishing one may make others ready.
+    //the declared symbols move into shared tables, and every thread, including this one,
+    //runs regions in its own private tables
+    map<string, Heterogeneous> shared;
+    map<string, ArrayStorage> sharedArrays;
+    map<string, Heterogeneous> declared (symTable);
+    long long declaredSteps = stepCount;
+    long long declaredIterations = loopIterations;
+    shared.swap(symTable);
+    sharedArrays.swap(arrayTable);
+    vector<string> *sharedTokens = tokens;
+    vector<string> *sharedLexemes = lexemes;
+    vector<DecodedLiteral> *sharedLiterals = tokenLiterals;
+    mutex queueLock;
+    condition_variable changed;
+    int remaining = regions.size();
+    long long workerSteps = 0;
+    long long workerIterations = 0;
+    long long workerHits = 0;
+    long long workerMisses = 0;
+    long long workerDeopts = 0;
+    parallelFailed = INT_MAX;
+    runOnThreads(min(workers, (int) regions.size()), [&] (int worker) {
+        if ( worker != 0 ) {
+            tokens = sharedTokens;
+            lexemes = sharedLexemes;
+            tokenLiterals = sharedLiterals;
+        }
+        containedRun = true;
+        while ( true ) {
+            int r;
+            {
+                unique_lock<mutex> waiting (queueLock);
+                while ( ready.empty() && remaining > 0 ) {
+                    changed.wait(waiting);
+                }
+                if ( remaining == 0 ) {
+                    break;
+                }
+                r = ready.front();
+                ready.pop_front();
+            }
+            runRegion(regions[r], r, shared, sharedArrays);
+            lock_guard<mutex> finishing (queueLock);
+            remaining--;
+            for ( int i = 0; i < (int) regions[r].dependents.size(); i++ ) {
+                int dependent = regions[r].dependents[i];
+                if ( --regions[dependent].waitingOn == 0 ) {
+                    ready.push_back(dependent);
+                }
+            }
+            changed.notify_all();
+        }
+        containedRun = false;
+        nextSuspend = LLONG_MAX;
+        if ( worker != 0 ) {
+            tokens = 0;
+            lexemes = 0;
+            tokenLiterals = 0;
+
+            //the counters are thread_local, so hand this worker's back for --stats
+            lock_guard<mutex> counting (queueLock);
+            workerSteps += stepCount;
+            workerIterations += loopIterations;
+            workerHits += quickHits;
+            workerMisses += quickMisses;
+            workerDeopts += quickDeopts;
+        }
+    });
+    stepCount += workerSteps;
+    loopIterations += workerIterations;
+    quickHits += workerHits;
+    quickMisses += workerMisses;
+    quickDeopts += workerDeopts;
+
+    symTable.swap(shared);
+    arrayTable.swap(sharedArrays);
+
+    //a stuck region means the scanner and the grammar functions disagree about where a
+    //statement ends, so nothing the regions did can be trusted: start over from the
+    //declarations (arrays zeroed again) and run the statements sequentially
+    for ( int r = 0; r < (int) regions.size(); r++ ) {
+        if ( regions[r].stuck ) {
+            symTable.swap(declared);
+            arrayTable.clear();
+            for ( map<string, Heterogeneous>::iterator it = symTable.begin(); it != symTable.end(); ++it ) {
+                if ( isArrayType(it->second.type) ) {
+                    allocateArray(it->first, it->second);
+                }
+            }
+            stepCount = declaredSteps;
+            loopIterations = declaredIterations;
+            currToken = firstStatement;
+            programStatements();
+            return 0;
+        }
+    }
+
+    //output in program order, up to and including the first region that failed; a region
+    //that hit a hardware trap or an exception ends the process the way a sequential run would
+    for ( int r = 0; r < (int) regions.size(); r++ ) {
+        cout << regions[r].output << flush;
+        if ( regions[r].error ) {
+            rethrow_exception(regions[r].error);
+        }
+        if ( regions[r].failed && regions[r].status == 128 + SIGFPE ) {
+            signal(SIGFPE, SIG_DFL);
+            raise(SIGFPE);
+        }
+        if ( regions[r].failed ) {
+            return regions[r].status;
+        }
+    }
+    currToken = pos;
+    programStatements();
+    return 0;
+}
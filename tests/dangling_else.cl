@@ -0,0 +1,7 @@
+int main() {
+int x, y;
+x = 1; y = 0;
+if (x < 2) y = 1; else y = 2; else y = 3;
+print y;
+return 0;
+}
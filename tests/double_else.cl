@@ -0,0 +1,6 @@
+int main() {
+int x;
+x = 1;
+if (true) print x; else print 2; else x = 5; print x;
+return 0;
+}
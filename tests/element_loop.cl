@@ -0,0 +1,21 @@
+int main() {
+int a[10], b[10];
+int i, n, big;
+n = 10;
+big = 2147483647;
+i = 0;
+while (i < n) if (true) b[i] = i * i - 3; else i = i + 1;
+i = 0;
+while (i <= 8) if (true) a[i] = (b[i] + i) * 2 - b[i] * 3 + big; else i = i + 2;
+print i;
+print a[0];
+print a[8];
+print a[9];
+i = 1;
+while (i < n) if (true) a[i] = a[i] * 0 + i; else i = i + 3;
+print a[7];
+i = 0;
+while (i < 11) if (true) b[i] = 1; else i = i + 1;
+print b[9];
+return 0;
+}
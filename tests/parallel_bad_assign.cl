@@ -0,0 +1,6 @@
+int main() {
+int x, y, z;
+x = 1; y = 2;
+z = x + y; print z; x = ; print x;
+return 0;
+}
@@ -0,0 +1,6 @@
+int main() {
+int x, y;
+x = 0; y = 0;
+if (true) print x; else print 2; print y; y = x + 1; if (true) print x; else print 2; else x = 5; print y;
+return 0;
+}
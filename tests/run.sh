@@ -0,0 +1,40 @@
+#!/bin/sh
+#run from the repository root after compiling:	sh tests/run.sh [./semantics]
+#each NAME.cl is run as source; its output must match NAME.out, and the output of
+#"--check" must match NAME.check when that file exists.  Every program must also give
+#the same output and status with "--parallel" as without it, and must not hang
+
+semantics=${1:-./semantics}
+failed=0
+
+for program in tests/*.cl; do
+    name=${program%.cl}
+    if [ -f "$name.out" ]; then
+        "$semantics" --source "$program" > /tmp/semantics_test.$$ 2>/dev/null
+        if ! cmp -s /tmp/semantics_test.$$ "$name.out"; then
+            echo "FAIL run: $program"
+            failed=1
+        fi
+    fi
+    "$semantics" --source "$program" > /tmp/semantics_seq.$$ 2>/dev/null
+    sequential=$?
+    timeout 10 "$semantics" --parallel --workers 4 --source "$program" > /tmp/semantics_par.$$ 2>/dev/null
+    parallel=$?
+    if [ $sequential -ne $parallel ] || ! cmp -s /tmp/semantics_seq.$$ /tmp/semantics_par.$$; then
+        echo "FAIL parallel: $program (status $sequential, parallel $parallel)"
+        failed=1
+    fi
+    if [ -f "$name.check" ]; then
+        "$semantics" --check --source "$program" > /tmp/semantics_test.$$ 2>/dev/null
+        if ! cmp -s /tmp/semantics_test.$$ "$name.check"; then
+            echo "FAIL check: $program"
+            failed=1
+        fi
+    fi
+done
+
+rm -f /tmp/semantics_test.$$ /tmp/semantics_seq.$$ /tmp/semantics_par.$$
+if [ $failed -eq 0 ]; then
+    echo "all tests passed"
+fi
+exit $failed